@@ -0,0 +1,302 @@
+// Headless physics benchmark. Builds piles of spheres falling onto a ground box like the
+// scene in main.cpp, steps them for a fixed number of frames and reports how long each
+// phase of the step took as percentiles, so runs of different engine versions can be compared.
+//
+// Usage: PhysicsBenchmark [--counts 100,1000,10000,100000] [--frames 300] [--warmup 30]
+//                         [--workers N] [--broadphase tree|grid] [--format csv|json] [--output file]
+
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/glm.hpp>
+#include <PhysicsWorld.h>
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <cstdint>
+#include <chrono>
+
+struct BenchmarkOptions {
+    std::vector<int> counts;
+    int frames = 300;
+    int warmup = 30;
+    int workers = -1;
+    BroadphaseType broadphase = BroadphaseType::DynamicTree;
+    bool json = false;
+    const char* output = nullptr;
+};
+
+struct PhaseStats {
+    double mean = 0.0;
+    double p50 = 0.0;
+    double p90 = 0.0;
+    double p99 = 0.0;
+    double max = 0.0;
+};
+
+struct SceneResult {
+    int count;
+    int frames;
+    unsigned workers;
+    size_t contacts;
+    uint32_t awakeBodies;
+    double setupMs;
+    PhaseStats phases[5];
+};
+
+static const char* phaseNames[] = { "broadphase", "narrowphase", "solve", "integrate", "total" };
+static const int phaseCount = 5;
+
+static void printUsage() {
+    std::printf("Usage: PhysicsBenchmark [--counts 100,1000,10000,100000] [--frames 300] [--warmup 30]\n"
+        "                        [--workers N] [--broadphase tree|grid] [--format csv|json] [--output file]\n");
+}
+
+static bool parseCounts(const char* text, std::vector<int>& counts) {
+    counts.clear();
+    while (*text) {
+        char* end;
+        long value = std::strtol(text, &end, 10);
+        if (end == text || value <= 0) {
+            return false;
+        }
+        counts.push_back((int)value);
+        text = *end == ',' ? end + 1 : end;
+    }
+    return !counts.empty();
+}
+
+static bool parseOptions(int argc, char** argv, BenchmarkOptions& options) {
+    options.counts = { 100, 1000, 10000, 100000 };
+    for (int i = 1; i < argc; ++i) {
+        const char* argument = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (std::strcmp(argument, "--help") == 0) {
+            return false;
+        }
+        if (!value) {
+            std::fprintf(stderr, "Missing value for %s\n", argument);
+            return false;
+        }
+
+        if (std::strcmp(argument, "--counts") == 0) {
+            if (!parseCounts(value, options.counts)) {
+                std::fprintf(stderr, "Invalid sphere counts: %s\n", value);
+                return false;
+            }
+        }
+        else if (std::strcmp(argument, "--frames") == 0) {
+            options.frames = std::max(std::atoi(value), 1);
+        }
+        else if (std::strcmp(argument, "--warmup") == 0) {
+            options.warmup = std::max(std::atoi(value), 0);
+        }
+        else if (std::strcmp(argument, "--workers") == 0) {
+            options.workers = std::max(std::atoi(value), 0);
+        }
+        else if (std::strcmp(argument, "--broadphase") == 0) {
+            if (std::strcmp(value, "tree") == 0) {
+                options.broadphase = BroadphaseType::DynamicTree;
+            }
+            else if (std::strcmp(value, "grid") == 0) {
+                options.broadphase = BroadphaseType::SpatialHash;
+            }
+            else {
+                std::fprintf(stderr, "Unknown broadphase: %s\n", value);
+                return false;
+            }
+        }
+        else if (std::strcmp(argument, "--format") == 0) {
+            if (std::strcmp(value, "json") == 0) {
+                options.json = true;
+            }
+            else if (std::strcmp(value, "csv") == 0) {
+                options.json = false;
+            }
+            else {
+                std::fprintf(stderr, "Unknown format: %s\n", value);
+                return false;
+            }
+        }
+        else if (std::strcmp(argument, "--output") == 0) {
+            options.output = value;
+        }
+        else {
+            std::fprintf(stderr, "Unknown option: %s\n", argument);
+            return false;
+        }
+        ++i;
+    }
+    return true;
+}
+
+// Nearest rank percentile of sorted samples
+static double percentile(const std::vector<double>& sorted, double fraction) {
+    size_t rank = (size_t)std::ceil(fraction * sorted.size());
+    return sorted[std::min(std::max(rank, (size_t)1), sorted.size()) - 1];
+}
+
+static PhaseStats computeStats(std::vector<double>& samples) {
+    PhaseStats stats;
+    std::sort(samples.begin(), samples.end());
+    for (size_t i = 0; i < samples.size(); ++i) {
+        stats.mean += samples[i];
+    }
+    stats.mean /= samples.size();
+    stats.p50 = percentile(samples, 0.50);
+    stats.p90 = percentile(samples, 0.90);
+    stats.p99 = percentile(samples, 0.99);
+    stats.max = samples.back();
+    return stats;
+}
+
+// Ground box plus count spheres stacked in layers above it. The box grows with the pile, a
+// small deterministic jitter keeps the columns from balancing on top of each other forever.
+static void buildScene(PhysicsWorld& world, int count) {
+    const float radius = 1.0f;
+    const float spacing = 2.2f;
+    const int layers = 10;
+    int side = (int)std::ceil(std::sqrt((double)count / layers));
+    float halfExtent = std::max(side * spacing * 0.5f + radius, 10.0f);
+
+    world.reserve(count + 1);
+
+    Rigidbody ground(glm::vec3(0.0f, -5.0f, 0.0f), 10000.0f, glm::vec3(0.0f),
+        glm::vec3(-halfExtent, -1.0f, -halfExtent), glm::vec3(halfExtent, 1.0f, halfExtent));
+    ground.setStatic(true);
+    world.addBody(ground);
+
+    std::vector<glm::vec3> positions(count);
+    uint32_t seed = 12345u;
+    for (int i = 0; i < count; ++i) {
+        int layer = i / (side * side);
+        int row = (i / side) % side;
+        int column = i % side;
+
+        seed = seed * 1664525u + 1013904223u;
+        float jitterX = ((seed >> 8) & 0xFFFF) / 65535.0f - 0.5f;
+        seed = seed * 1664525u + 1013904223u;
+        float jitterZ = ((seed >> 8) & 0xFFFF) / 65535.0f - 0.5f;
+
+        positions[i] = glm::vec3((column - (side - 1) * 0.5f) * spacing + jitterX * 0.1f,
+            -2.0f + layer * spacing,
+            (row - (side - 1) * 0.5f) * spacing + jitterZ * 0.1f);
+    }
+
+    std::vector<BodyHandle> handles(count);
+    Rigidbody sphere(glm::vec3(0.0f), 10.0f, glm::vec3(0.0f, -5.8f, 0.0f), radius);
+    world.addBodies(sphere, positions.data(), count, handles.data());
+}
+
+static SceneResult runScene(const BenchmarkOptions& options, int count) {
+    typedef std::chrono::steady_clock Clock;
+
+    SceneResult result;
+    result.count = count;
+    result.frames = options.frames;
+
+    Clock::time_point setupStart = Clock::now();
+    PhysicsWorld world(options.broadphase);
+    if (options.workers >= 0) {
+        world.setWorkerCount((unsigned)options.workers);
+    }
+    buildScene(world, count);
+    result.setupMs = std::chrono::duration<double, std::milli>(Clock::now() - setupStart).count();
+    result.workers = world.getWorkerCount();
+
+    for (int frame = 0; frame < options.warmup; ++frame) {
+        world.fixedStep(world.getFixedTimeStep());
+    }
+
+    std::vector<double> samples[phaseCount];
+    for (int phase = 0; phase < phaseCount; ++phase) {
+        samples[phase].reserve(options.frames);
+    }
+
+    for (int frame = 0; frame < options.frames; ++frame) {
+        world.fixedStep(world.getFixedTimeStep());
+
+        const PhysicsProfile& profile = world.getProfile();
+        samples[0].push_back(profile.broadphase);
+        samples[1].push_back(profile.narrowphase);
+        samples[2].push_back(profile.solve);
+        // Sleep bookkeeping is part of the per body work at the end of the step
+        samples[3].push_back(profile.integrate + profile.sleep);
+        samples[4].push_back(profile.total);
+    }
+
+    for (int phase = 0; phase < phaseCount; ++phase) {
+        result.phases[phase] = computeStats(samples[phase]);
+    }
+    result.contacts = world.getContacts().size();
+    result.awakeBodies = world.getAwakeBodyCount();
+    return result;
+}
+
+static void writeCsv(FILE* file, const std::vector<SceneResult>& results) {
+    std::fprintf(file, "spheres,frames,workers,phase,mean_ms,p50_ms,p90_ms,p99_ms,max_ms\n");
+    for (size_t i = 0; i < results.size(); ++i) {
+        const SceneResult& result = results[i];
+        for (int phase = 0; phase < phaseCount; ++phase) {
+            const PhaseStats& stats = result.phases[phase];
+            std::fprintf(file, "%d,%d,%u,%s,%.4f,%.4f,%.4f,%.4f,%.4f\n", result.count, result.frames, result.workers,
+                phaseNames[phase], stats.mean, stats.p50, stats.p90, stats.p99, stats.max);
+        }
+    }
+}
+
+static void writeJson(FILE* file, const std::vector<SceneResult>& results, const BenchmarkOptions& options) {
+    std::fprintf(file, "{\n  \"broadphase\": \"%s\",\n  \"scenes\": [\n",
+        options.broadphase == BroadphaseType::DynamicTree ? "tree" : "grid");
+    for (size_t i = 0; i < results.size(); ++i) {
+        const SceneResult& result = results[i];
+        std::fprintf(file, "    {\n      \"spheres\": %d,\n      \"frames\": %d,\n      \"workers\": %u,\n"
+            "      \"setup_ms\": %.4f,\n      \"contacts\": %zu,\n      \"awake_bodies\": %u,\n      \"phases\": {\n",
+            result.count, result.frames, result.workers, result.setupMs, result.contacts, result.awakeBodies);
+        for (int phase = 0; phase < phaseCount; ++phase) {
+            const PhaseStats& stats = result.phases[phase];
+            std::fprintf(file, "        \"%s\": { \"mean_ms\": %.4f, \"p50_ms\": %.4f, \"p90_ms\": %.4f, \"p99_ms\": %.4f, \"max_ms\": %.4f }%s\n",
+                phaseNames[phase], stats.mean, stats.p50, stats.p90, stats.p99, stats.max, phase + 1 < phaseCount ? "," : "");
+        }
+        std::fprintf(file, "      }\n    }%s\n", i + 1 < results.size() ? "," : "");
+    }
+    std::fprintf(file, "  ]\n}\n");
+}
+
+int main(int argc, char** argv) {
+    BenchmarkOptions options;
+    if (!parseOptions(argc, argv, options)) {
+        printUsage();
+        return 1;
+    }
+
+    std::vector<SceneResult> results;
+    for (size_t i = 0; i < options.counts.size(); ++i) {
+        std::fprintf(stderr, "Simulating %d spheres for %d frames...\n", options.counts[i], options.frames);
+        results.push_back(runScene(options, options.counts[i]));
+    }
+
+    FILE* file = stdout;
+    if (options.output) {
+        file = std::fopen(options.output, "w");
+        if (!file) {
+            std::fprintf(stderr, "Failed to open %s\n", options.output);
+            return 1;
+        }
+    }
+
+    if (options.json) {
+        writeJson(file, results, options);
+    }
+    else {
+        writeCsv(file, results);
+    }
+
+    if (file != stdout) {
+        std::fclose(file);
+    }
+    return 0;
+}
@@ -0,0 +1,34 @@
+#ifndef AABB_H
+#define AABB_H
+
+#include <glm/glm.hpp>
+
+#include <cmath>
+
+// Axis aligned bounding box in world space, used by the broadphase
+struct AABB {
+    glm::vec3 min;
+    glm::vec3 max;
+
+    AABB() : min(0.0f), max(0.0f) {}
+    AABB(glm::vec3 boxMin, glm::vec3 boxMax) : min(boxMin), max(boxMax) {}
+
+    bool overlaps(const AABB& other) const {
+        return (max.x >= other.min.x && min.x <= other.max.x &&
+            max.y >= other.min.y && min.y <= other.max.y &&
+            max.z >= other.min.z && min.z <= other.max.z);
+    }
+};
+
+// Inverse of a ray direction for slab tests. Axes the ray runs parallel to get a huge but
+// finite inverse, so the origin has to lie inside that slab instead of the test going NaN
+inline glm::vec3 rayInverseDirection(const glm::vec3& direction) {
+    glm::vec3 inverse;
+    for (int axis = 0; axis < 3; ++axis) {
+        float d = std::abs(direction[axis]) < 1e-8f ? (direction[axis] < 0.0f ? -1e-8f : 1e-8f) : direction[axis];
+        inverse[axis] = 1.0f / d;
+    }
+    return inverse;
+}
+
+#endif
@@ -0,0 +1,301 @@
+#ifndef BODY_STORAGE_H
+#define BODY_STORAGE_H
+
+#include <glm/glm.hpp>
+#include <Rigidbody.h>
+
+#include <vector>
+#include <cstdint>
+#include <utility>
+#include <algorithm>
+
+// Stable reference to a body inside a PhysicsWorld. The dense index of a body changes
+// whenever bodies are removed, the handle doesn't. Slots of removed bodies get reused, the
+// generation tells a handle to the removed body apart from one to the body now in its slot.
+struct BodyHandle {
+    uint32_t id = 0xFFFFFFFFu;
+    uint32_t generation = 0;
+
+    bool operator==(const BodyHandle& other) const { return id == other.id && generation == other.generation; }
+    bool operator!=(const BodyHandle& other) const { return !(*this == other); }
+};
+
+// Body state stored as one array per component, so the integration kernels can stream
+// through positions and velocities of many bodies at once.
+struct BodyStorage {
+    std::vector<float> positionX, positionY, positionZ;
+    std::vector<float> velocityX, velocityY, velocityZ;
+    std::vector<float> forceX, forceY, forceZ;
+    std::vector<float> gravityX, gravityY, gravityZ;
+    std::vector<float> rotationX, rotationY, rotationZ;
+    std::vector<float> angularVelocityX, angularVelocityY, angularVelocityZ;
+    // State before the last fixed step, rendering interpolates from here to the current state
+    std::vector<float> previousPositionX, previousPositionY, previousPositionZ;
+    std::vector<float> previousRotationX, previousRotationY, previousRotationZ;
+    std::vector<float> mass;
+    std::vector<float> inverseMass;
+    // Seconds the body has been moving slower than the sleep thresholds
+    std::vector<float> sleepTimer;
+    // Physics level of detail bucket, see PhysicsWorld::setLodFocusPoints
+    std::vector<uint8_t> lodLevel;
+
+    // Collider data
+    std::vector<uint8_t> colliderType;
+    // 1 for bodies with continuous collision detection
+    std::vector<uint8_t> continuous;
+    std::vector<float> radius;
+    std::vector<glm::vec3> boundingBoxMin;
+    std::vector<glm::vec3> boundingBoxMax;
+    // Unrotated bounds and collider rotation of oriented boxes
+    std::vector<glm::vec3> localBoxMin;
+    std::vector<glm::vec3> localBoxMax;
+    std::vector<glm::quat> colliderOrientation;
+    // Body rotation combined with the collider rotation, only kept for oriented boxes. It is
+    // updated when the rotation is written, so collision tests and queries don't turn the
+    // Euler angles into a quaternion on every call.
+    std::vector<glm::quat> boxOrientation;
+    // Collision layer bits and the mask given by the body. filterMask is that mask with the
+    // layer matrix of the world applied, the broadphase only looks at it.
+    std::vector<uint32_t> collisionLayer;
+    std::vector<uint32_t> collisionMask;
+    std::vector<uint32_t> filterMask;
+
+    // Handle slot of the body at each dense index
+    std::vector<uint32_t> handles;
+
+    // Number of oriented boxes, updateOrientations has nothing to do without any
+    size_t orientedBoxCount = 0;
+
+    size_t size() const {
+        return handles.size();
+    }
+
+    // Calls function on every per body array
+    template <typename Function>
+    void forEachField(Function function) {
+        function(positionX); function(positionY); function(positionZ);
+        function(velocityX); function(velocityY); function(velocityZ);
+        function(forceX); function(forceY); function(forceZ);
+        function(gravityX); function(gravityY); function(gravityZ);
+        function(rotationX); function(rotationY); function(rotationZ);
+        function(angularVelocityX); function(angularVelocityY); function(angularVelocityZ);
+        function(previousPositionX); function(previousPositionY); function(previousPositionZ);
+        function(previousRotationX); function(previousRotationY); function(previousRotationZ);
+        function(mass);
+        function(inverseMass);
+        function(sleepTimer);
+        function(lodLevel);
+        function(colliderType);
+        function(continuous);
+        function(radius);
+        function(boundingBoxMin);
+        function(boundingBoxMax);
+        function(localBoxMin);
+        function(localBoxMax);
+        function(colliderOrientation);
+        function(boxOrientation);
+        function(collisionLayer);
+        function(collisionMask);
+        function(filterMask);
+        function(handles);
+    }
+
+    void reserve(size_t count) {
+        forEachField([count](auto& field) { field.reserve(count); });
+    }
+
+    void push(const Rigidbody& body, uint32_t handle) {
+        size_t index = size();
+        forEachField([](auto& field) { field.emplace_back(); });
+
+        setPosition(index, body.getPosition());
+        setVelocity(index, body.getVelocity());
+        setForce(index, body.getForce());
+        setGravity(index, body.getGravity());
+        setRotation(index, body.getRotation());
+        setAngularVelocity(index, body.getAngularVelocity());
+        storePreviousState(index, index + 1);
+        mass[index] = body.getMass();
+        inverseMass[index] = body.getMass() > 0.0f ? 1.0f / body.getMass() : 0.0f;
+        sleepTimer[index] = 0.0f;
+        lodLevel[index] = 0;
+
+        // Static bodies are stored with zero inverse mass and no motion, so integration
+        // leaves them in place and impulses never push them
+        if (body.isStatic()) {
+            inverseMass[index] = 0.0f;
+            setVelocity(index, glm::vec3(0.0f));
+            setGravity(index, glm::vec3(0.0f));
+            setAngularVelocity(index, glm::vec3(0.0f));
+        }
+
+        colliderType[index] = (uint8_t)body.colliderType;
+        continuous[index] = body.isContinuous() ? 1 : 0;
+        if (body.colliderType == Rigidbody::ColliderType::Sphere) {
+            radius[index] = body.getRadius();
+            boundingBoxMin[index] = glm::vec3(-body.getRadius());
+            boundingBoxMax[index] = glm::vec3(body.getRadius());
+        }
+        else {
+            // Collider rotation is baked in once, the same way getBoundingBoxMin/Max apply it
+            glm::vec3 rotatedMin = body.getBoundingBoxMin();
+            glm::vec3 rotatedMax = body.getBoundingBoxMax();
+            radius[index] = 0.0f;
+            boundingBoxMin[index] = glm::min(rotatedMin, rotatedMax);
+            boundingBoxMax[index] = glm::max(rotatedMin, rotatedMax);
+        }
+        localBoxMin[index] = body.getLocalBoundingBoxMin();
+        localBoxMax[index] = body.getLocalBoundingBoxMax();
+        colliderOrientation[index] = body.getColliderOrientation();
+        if (isOrientedBox(index)) {
+            updateOrientation(index);
+            ++orientedBoxCount;
+        }
+        collisionLayer[index] = body.getCollisionLayer();
+        collisionMask[index] = body.getCollisionMask();
+        filterMask[index] = body.getCollisionMask();
+
+        handles[index] = handle;
+    }
+
+    // Whether the filters of both bodies let them collide
+    bool canCollide(size_t a, size_t b) const {
+        return (collisionLayer[a] & filterMask[b]) != 0 && (collisionLayer[b] & filterMask[a]) != 0;
+    }
+
+    void swap(size_t a, size_t b) {
+        forEachField([a, b](auto& field) { std::swap(field[a], field[b]); });
+    }
+
+    void pop() {
+        if (isOrientedBox(size() - 1)) {
+            --orientedBoxCount;
+        }
+        forEachField([](auto& field) { field.pop_back(); });
+    }
+
+    glm::vec3 getPosition(size_t index) const {
+        return glm::vec3(positionX[index], positionY[index], positionZ[index]);
+    }
+
+    void setPosition(size_t index, const glm::vec3& value) {
+        positionX[index] = value.x;
+        positionY[index] = value.y;
+        positionZ[index] = value.z;
+    }
+
+    glm::vec3 getVelocity(size_t index) const {
+        return glm::vec3(velocityX[index], velocityY[index], velocityZ[index]);
+    }
+
+    void setVelocity(size_t index, const glm::vec3& value) {
+        velocityX[index] = value.x;
+        velocityY[index] = value.y;
+        velocityZ[index] = value.z;
+    }
+
+    glm::vec3 getForce(size_t index) const {
+        return glm::vec3(forceX[index], forceY[index], forceZ[index]);
+    }
+
+    void setForce(size_t index, const glm::vec3& value) {
+        forceX[index] = value.x;
+        forceY[index] = value.y;
+        forceZ[index] = value.z;
+    }
+
+    glm::vec3 getGravity(size_t index) const {
+        return glm::vec3(gravityX[index], gravityY[index], gravityZ[index]);
+    }
+
+    void setGravity(size_t index, const glm::vec3& value) {
+        gravityX[index] = value.x;
+        gravityY[index] = value.y;
+        gravityZ[index] = value.z;
+    }
+
+    glm::vec3 getRotation(size_t index) const {
+        return glm::vec3(rotationX[index], rotationY[index], rotationZ[index]);
+    }
+
+    void setRotation(size_t index, const glm::vec3& value) {
+        rotationX[index] = value.x;
+        rotationY[index] = value.y;
+        rotationZ[index] = value.z;
+        if (isOrientedBox(index)) {
+            updateOrientation(index);
+        }
+    }
+
+    void updateOrientation(size_t index) {
+        boxOrientation[index] = Transform::eulerToQuaternion(getRotation(index)) * colliderOrientation[index];
+    }
+
+    // For the integration kernels, which write the rotation arrays directly. Only boxes with
+    // angular velocity turned, the others keep their orientation.
+    void updateOrientations(size_t begin, size_t end) {
+        if (orientedBoxCount == 0) {
+            return;
+        }
+        for (size_t i = begin; i < end; ++i) {
+            if (isOrientedBox(i) && (angularVelocityX[i] != 0.0f || angularVelocityY[i] != 0.0f || angularVelocityZ[i] != 0.0f)) {
+                updateOrientation(i);
+            }
+        }
+    }
+
+    glm::vec3 getAngularVelocity(size_t index) const {
+        return glm::vec3(angularVelocityX[index], angularVelocityY[index], angularVelocityZ[index]);
+    }
+
+    void setAngularVelocity(size_t index, const glm::vec3& value) {
+        angularVelocityX[index] = value.x;
+        angularVelocityY[index] = value.y;
+        angularVelocityZ[index] = value.z;
+    }
+
+    // Copies the current positions and rotations of [begin, end) into the previous state
+    void storePreviousState(size_t begin, size_t end) {
+        std::copy(positionX.begin() + begin, positionX.begin() + end, previousPositionX.begin() + begin);
+        std::copy(positionY.begin() + begin, positionY.begin() + end, previousPositionY.begin() + begin);
+        std::copy(positionZ.begin() + begin, positionZ.begin() + end, previousPositionZ.begin() + begin);
+        std::copy(rotationX.begin() + begin, rotationX.begin() + end, previousRotationX.begin() + begin);
+        std::copy(rotationY.begin() + begin, rotationY.begin() + end, previousRotationY.begin() + begin);
+        std::copy(rotationZ.begin() + begin, rotationZ.begin() + end, previousRotationZ.begin() + begin);
+    }
+
+    glm::vec3 getPreviousPosition(size_t index) const {
+        return glm::vec3(previousPositionX[index], previousPositionY[index], previousPositionZ[index]);
+    }
+
+    glm::vec3 getPreviousRotation(size_t index) const {
+        return glm::vec3(previousRotationX[index], previousRotationY[index], previousRotationZ[index]);
+    }
+
+    bool isStatic(size_t index) const {
+        return inverseMass[index] == 0.0f;
+    }
+
+    bool isOrientedBox(size_t index) const {
+        return colliderType[index] == (uint8_t)Rigidbody::ColliderType::OrientedBox;
+    }
+
+    // Oriented boxes turn with the body, other boxes stay axis aligned
+    OrientedBox getOrientedBox(size_t index) const {
+        if (!isOrientedBox(index)) {
+            return OrientedBox(getAABB(index));
+        }
+        return OrientedBox(getPosition(index), boxOrientation[index], localBoxMin[index], localBoxMax[index]);
+    }
+
+    // World space collider bounds
+    AABB getAABB(size_t index) const {
+        if (isOrientedBox(index)) {
+            return getOrientedBox(index).getAABB();
+        }
+        glm::vec3 position = getPosition(index);
+        return AABB(position + boundingBoxMin[index], position + boundingBoxMax[index]);
+    }
+};
+
+#endif
@@ -1,7 +1,12 @@
 #ifndef COLLISION_CLASS_H
 #define COLLISION_CLASS_H
 
+#include <glm/gtx/norm.hpp>
 #include <Rigidbody.h>
+#include <CollisionDispatch.h>
+
+#include <cmath>
+#include <algorithm>
 
 class CollisionDetector {
 public:
@@ -44,22 +49,219 @@ public:
         return distanceSquared > 0;
     }
 
-    // Overloaded collision detection method to handle different types of colliders
-    static bool detectCollisions(Rigidbody& rb1, Rigidbody& rb2) {
-        if (rb1.colliderType == Rigidbody::ColliderType::BoundingBox && rb2.colliderType == Rigidbody::ColliderType::BoundingBox) {
-            return detectBoundingBoxCollision(rb1, rb2);
+    // Ray vs sphere, direction must be normalized. Writes the hit distance along the ray.
+    static bool raycastSphere(const glm::vec3& origin, const glm::vec3& direction, float maxDistance,
+        const glm::vec3& center, float radius, float& distance) {
+        glm::vec3 toOrigin = origin - center;
+        float b = glm::dot(toOrigin, direction);
+        float c = glm::dot(toOrigin, toOrigin) - radius * radius;
+
+        // Ray starts outside and points away
+        if (c > 0.0f && b > 0.0f) {
+            return false;
         }
-        else if (rb1.colliderType == Rigidbody::ColliderType::Sphere && rb2.colliderType == Rigidbody::ColliderType::Sphere) {
-            return detectSphereCollision(rb1, rb2);
+
+        float discriminant = b * b - c;
+        if (discriminant < 0.0f) {
+            return false;
         }
-        else if (rb1.colliderType == Rigidbody::ColliderType::Sphere && rb2.colliderType == Rigidbody::ColliderType::BoundingBox) {
-            return detectSphereBoundingBoxCollision(rb1, rb2);
+
+        distance = std::max(-b - std::sqrt(discriminant), 0.0f);
+        return distance <= maxDistance;
+    }
+
+    // Ray vs axis aligned box, writes the hit distance and the normal of the face that was hit
+    static bool raycastBox(const glm::vec3& origin, const glm::vec3& direction, float maxDistance,
+        const glm::vec3& boxMin, const glm::vec3& boxMax, float& distance, glm::vec3& normal) {
+        float enter = 0.0f;
+        float exit = maxDistance;
+        normal = glm::vec3(0.0f);
+
+        for (int axis = 0; axis < 3; ++axis) {
+            if (std::abs(direction[axis]) < 1e-8f) {
+                // Parallel to the slab, must start inside it
+                if (origin[axis] < boxMin[axis] || origin[axis] > boxMax[axis]) {
+                    return false;
+                }
+                continue;
+            }
+
+            float inverse = 1.0f / direction[axis];
+            float t1 = (boxMin[axis] - origin[axis]) * inverse;
+            float t2 = (boxMax[axis] - origin[axis]) * inverse;
+            float sign = -1.0f;
+            if (t1 > t2) {
+                std::swap(t1, t2);
+                sign = 1.0f;
+            }
+
+            if (t1 > enter) {
+                enter = t1;
+                normal = glm::vec3(0.0f);
+                normal[axis] = sign;
+            }
+            exit = std::min(exit, t2);
+            if (enter > exit) {
+                return false;
+            }
         }
-        else if (rb1.colliderType == Rigidbody::ColliderType::BoundingBox && rb2.colliderType == Rigidbody::ColliderType::Sphere) {
-            return detectSphereBoundingBoxCollision(rb2, rb1);
+
+        distance = enter;
+        return true;
+    }
+
+    // Sphere moving from start to end against an axis aligned box. Writes the fraction of the
+    // motion at the first touch and the face normal there. The box is grown by the radius,
+    // which is slightly conservative around its edges and corners.
+    static bool sweepSphereBox(const glm::vec3& start, const glm::vec3& end, float radius,
+        const glm::vec3& boxMin, const glm::vec3& boxMax, float& fraction, glm::vec3& normal) {
+        glm::vec3 motion = end - start;
+        float length = glm::length(motion);
+        if (length < 1e-6f) {
+            return false;
         }
+
+        float distance;
+        if (!raycastBox(start, motion / length, length, boxMin - glm::vec3(radius), boxMax + glm::vec3(radius), distance, normal)) {
+            return false;
+        }
+
+        // Already touching at the start, the regular contacts handle that
+        if (normal == glm::vec3(0.0f)) {
+            return false;
+        }
+        fraction = distance / length;
+        return true;
+    }
+
+    // Detect sphere vs. oriented box collision, closest point taken in the box frame
+    static bool detectSphereOrientedBoxCollision(Rigidbody& sphere, Rigidbody& box) {
+        OrientedBox orientedBox = box.getOrientedBox();
+        glm::vec3 local = orientedBox.toLocal(sphere.getPosition());
+        glm::vec3 offset = local - glm::clamp(local, -orientedBox.halfExtents, orientedBox.halfExtents);
+        return glm::dot(offset, offset) <= sphere.getRadius() * sphere.getRadius();
+    }
+
+    // Pairs without a test here, meshes only collide inside the physics world
+    static bool detectNoCollision(Rigidbody&, Rigidbody&) {
         return false;
     }
+
+    // Looks the routine up in the shape pair table, the bodies come in the order it expects
+    static bool detectCollisions(Rigidbody& rb1, Rigidbody& rb2) {
+        typedef bool (*DetectFunction)(Rigidbody&, Rigidbody&);
+        // Same order as ShapePair
+        static const DetectFunction detectFunctions[shapePairCount] = {
+            detectSphereCollision,
+            detectSphereBoundingBoxCollision,
+            detectSphereOrientedBoxCollision,
+            detectNoCollision,
+            detectBoundingBoxCollision,
+            detectNoCollision
+        };
+
+        ShapePairRoute route = lookupShapePair((uint8_t)rb1.colliderType, (uint8_t)rb2.colliderType);
+        return route.swap ? detectFunctions[(size_t)route.pair](rb2, rb1) : detectFunctions[(size_t)route.pair](rb1, rb2);
+    }
 };
 
+inline void ResolveSphereCollision(Rigidbody& sphere1, Rigidbody& sphere2, float deltaTime) {
+
+    glm::vec3 pos1 = sphere1.getPosition();
+    glm::vec3 pos2 = sphere2.getPosition();
+    float radius1 = sphere1.getRadius();
+    float radius2 = sphere2.getRadius();
+
+    glm::vec3 collisionNormal = pos2 - pos1;
+    float distance = glm::length(collisionNormal);
+    float combinedRadii = radius1 + radius2;
+
+    // Check for collision
+    if (distance < combinedRadii) {
+        // Normalize the collision normal
+        collisionNormal = glm::normalize(collisionNormal);
+
+        // Calculate relative velocity
+        glm::vec3 relativeVelocity = sphere1.getVelocity() - sphere2.getVelocity();
+        float relativeVelocityNormal = glm::dot(relativeVelocity, collisionNormal);
+
+        // Calculate restitution (bounciness)
+        float restitution = 0.5f;
+
+        // Calculate impulse scalar
+        float j = -(1 + restitution) * relativeVelocityNormal;
+        j /= (1 / sphere1.getMass()) + (1 / sphere2.getMass());
+
+        // Calculate impulse vector
+        glm::vec3 impulse = j * collisionNormal;
+
+        // Apply impulse to the velocities
+        sphere1.setVelocity(sphere1.getVelocity() + impulse / sphere1.getMass());
+        sphere2.setVelocity(sphere2.getVelocity() - impulse / sphere2.getMass());
+
+        // Position correction
+        float penetrationDepth = combinedRadii - distance;
+        glm::vec3 correction = (penetrationDepth / ((1 / sphere1.getMass()) + (1 / sphere2.getMass()))) * collisionNormal;
+
+        sphere1.setPosition(pos1 - correction * (1 / sphere1.getMass()));
+        sphere2.setPosition(pos2 + correction * (1 / sphere2.getMass()));
+
+        glm::vec3 contactPoint = pos1 + collisionNormal * radius1;
+        glm::vec3 r1 = contactPoint - pos1;
+        glm::vec3 r2 = contactPoint - pos2;
+
+        glm::vec3 angularChange1 = r1 / sphere1.getMass();
+        glm::vec3 angularChange2 = r2 / sphere2.getMass();
+
+        
+        // Apply torque to rotation
+        sphere2.setAngularVelocity(sphere2.getAngularVelocity() + r2 * 0.5f);
+        sphere1.setAngularVelocity(sphere1.getAngularVelocity() + r1 * 0.5f);
+    }
+}
+
+
+inline void ResolveSphereVsBoundingBoxCollision(Rigidbody& sphere, Rigidbody& box) {
+    glm::vec3 spherePos = sphere.getPosition();
+    glm::vec3 boxMin = box.getBoundingBoxMin() + box.getPosition();
+    glm::vec3 boxMax = box.getBoundingBoxMax() + box.getPosition();
+
+    glm::vec3 closestPoint = glm::clamp(spherePos, boxMin, boxMax);
+    float distance = glm::distance(spherePos, closestPoint);
+
+    if (distance < sphere.getRadius()) {
+        glm::vec3 collisionNormal = glm::normalize(spherePos - closestPoint);
+        glm::vec3 relativeVelocity = sphere.getVelocity() - box.getVelocity();
+        float relativeVelocityNormal = glm::dot(relativeVelocity, collisionNormal);
+
+        float restitution = 0.1f;
+
+        float j = -(1 + restitution) * relativeVelocityNormal;
+        j /= 1 / sphere.getMass() + 1 / box.getMass();
+
+        glm::vec3 impulse = j * collisionNormal;
+
+        sphere.setVelocity(sphere.getVelocity() + impulse / sphere.getMass());
+
+        float penetrationDepth = sphere.getRadius() - distance;
+        glm::vec3 correction = penetrationDepth * collisionNormal;
+        sphere.setPosition(sphere.getPosition() + correction * (box.getMass() / (sphere.getMass() + box.getMass())));
+
+        // Calculate friction impulse
+        glm::vec3 tangent = relativeVelocity - relativeVelocityNormal * collisionNormal;
+        if (glm::length(tangent) > 0.0001f) {
+            tangent = glm::normalize(tangent);
+        }
+
+        float relativeVelocityTangent = glm::dot(relativeVelocity, tangent);
+        float frictionCoefficient = 0.05f; // This can be adjusted based on material properties
+        float jt = -relativeVelocityTangent;
+        jt /= 1 / sphere.getMass() + 1 / box.getMass();
+        jt = glm::clamp(jt, -j * frictionCoefficient, j * frictionCoefficient);
+
+        glm::vec3 frictionImpulse = jt * tangent;
+        sphere.setVelocity(sphere.getVelocity() + frictionImpulse / sphere.getMass());
+    }
+}
+
 #endif
\ No newline at end of file
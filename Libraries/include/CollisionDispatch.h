@@ -0,0 +1,112 @@
+#ifndef COLLISION_DISPATCH_H
+#define COLLISION_DISPATCH_H
+
+#include <Rigidbody.h>
+
+#include <array>
+#include <vector>
+#include <utility>
+#include <cstddef>
+#include <cstdint>
+
+// Narrowphase routine a pair of colliders goes through. Every routine takes its shapes in
+// a fixed order, see ShapePairRoute.
+enum class ShapePair : uint8_t {
+    SphereSphere,
+    SphereBox,
+    SphereOrientedBox,
+    SphereMesh,
+    // Axis aligned and oriented boxes in any mix
+    BoxBox,
+    // Shapes that don't collide with each other, like two meshes
+    None
+};
+
+const size_t colliderTypeCount = 4;
+const size_t shapePairCount = 6;
+
+// Routine for one pair of collider types and whether the two bodies have to swap places so
+// the first one matches the first shape of the routine
+struct ShapePairRoute {
+    ShapePair pair;
+    bool swap;
+};
+
+// Routing rules, only evaluated while building shapePairTable
+constexpr ShapePairRoute routeShapePair(Rigidbody::ColliderType a, Rigidbody::ColliderType b) {
+    typedef Rigidbody::ColliderType Type;
+    bool sphereA = a == Type::Sphere;
+    bool sphereB = b == Type::Sphere;
+    bool boxA = a == Type::BoundingBox || a == Type::OrientedBox;
+    bool boxB = b == Type::BoundingBox || b == Type::OrientedBox;
+
+    if (sphereA && sphereB) {
+        return ShapePairRoute{ ShapePair::SphereSphere, false };
+    }
+    if (boxA && boxB) {
+        return ShapePairRoute{ ShapePair::BoxBox, false };
+    }
+    if (sphereA || sphereB) {
+        Type other = sphereA ? b : a;
+        ShapePair pair = other == Type::BoundingBox ? ShapePair::SphereBox :
+            other == Type::OrientedBox ? ShapePair::SphereOrientedBox : ShapePair::SphereMesh;
+        return ShapePairRoute{ pair, sphereB };
+    }
+    return ShapePairRoute{ ShapePair::None, false };
+}
+
+typedef std::array<ShapePairRoute, colliderTypeCount * colliderTypeCount> ShapePairTable;
+
+constexpr ShapePairTable buildShapePairTable() {
+    ShapePairTable table{};
+    for (size_t a = 0; a < colliderTypeCount; ++a) {
+        for (size_t b = 0; b < colliderTypeCount; ++b) {
+            table[a * colliderTypeCount + b] = routeShapePair((Rigidbody::ColliderType)a, (Rigidbody::ColliderType)b);
+        }
+    }
+    return table;
+}
+
+// Every collider type pair resolved at compile time. A new shape grows the table and adds a
+// bucket, the lookup for the existing pairs stays a single load.
+constexpr ShapePairTable shapePairTable = buildShapePairTable();
+
+static_assert((size_t)Rigidbody::ColliderType::Mesh + 1 == colliderTypeCount, "Every collider type needs a row in the dispatch table");
+static_assert((size_t)ShapePair::None + 1 == shapePairCount, "Every shape pair needs a bucket");
+static_assert(shapePairTable[(size_t)Rigidbody::ColliderType::BoundingBox * colliderTypeCount + (size_t)Rigidbody::ColliderType::Sphere].swap,
+    "Sphere routines take the sphere first");
+
+inline ShapePairRoute lookupShapePair(uint8_t typeA, uint8_t typeB) {
+    return shapePairTable[typeA * colliderTypeCount + typeB];
+}
+
+// Candidate pairs sorted into one list per shape pair, each already in the order its routine
+// expects. The narrowphase then runs every list in its own loop without looking at types.
+struct ShapePairBuckets {
+    std::vector<std::pair<uint32_t, uint32_t>> pairs[shapePairCount];
+    // Position of every pair in the candidate list it came from
+    std::vector<uint32_t> sources[shapePairCount];
+
+    void clear() {
+        for (size_t i = 0; i < shapePairCount; ++i) {
+            pairs[i].clear();
+            sources[i].clear();
+        }
+    }
+
+    void add(uint32_t a, uint8_t typeA, uint32_t b, uint8_t typeB, uint32_t source) {
+        ShapePairRoute route = lookupShapePair(typeA, typeB);
+        pairs[(size_t)route.pair].push_back(route.swap ? std::make_pair(b, a) : std::make_pair(a, b));
+        sources[(size_t)route.pair].push_back(source);
+    }
+
+    const std::vector<std::pair<uint32_t, uint32_t>>& operator[](ShapePair pair) const {
+        return pairs[(size_t)pair];
+    }
+
+    const std::vector<uint32_t>& getSources(ShapePair pair) const {
+        return sources[(size_t)pair];
+    }
+};
+
+#endif
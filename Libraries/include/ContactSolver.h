@@ -0,0 +1,248 @@
+#ifndef CONTACT_SOLVER_H
+#define CONTACT_SOLVER_H
+
+#include <glm/glm.hpp>
+#include <BodyStorage.h>
+#include <Narrowphase.h>
+
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <utility>
+
+// Impulses one contact of a pair of bodies ended the last step with, keyed by their handles
+// and the contact's number within the pair, so pairs with several contacts like a sphere
+// on a mesh crease warm start each contact from its own impulse
+struct ContactManifold {
+    uint64_t key;
+    uint32_t feature;
+    uint32_t handleA;
+    float normalImpulse;
+    glm::vec3 tangentImpulse;
+
+    bool operator<(const ContactManifold& other) const {
+        return key < other.key || (key == other.key && feature < other.feature);
+    }
+};
+
+// Non penetration and friction constraint of one contact
+struct ContactConstraint {
+    uint32_t bodyA;
+    uint32_t bodyB;
+    glm::vec3 normal;
+    float inverseMassA;
+    float inverseMassB;
+    // 1 / (inverseMassA + inverseMassB), the same for the normal and the tangent direction
+    float effectiveMass;
+    // Target separating velocity, from restitution and penetration recovery. Negative for
+    // speculative contacts, which may close the remaining gap but not more.
+    float bias;
+    float friction;
+    float normalImpulse;
+    glm::vec3 tangentImpulse;
+    // Number of the contact among the contacts of its pair, see ContactManifold
+    uint32_t feature;
+};
+
+// Sequential impulse solver. Every contact is a constraint that accumulates its impulse over
+// several iterations, the accumulated impulses are kept per body pair and applied again at
+// the start of the next step, so resting stacks start out already balanced.
+class ContactSolver {
+public:
+    // Fraction of the penetration removed per step and the depth that is left alone
+    static constexpr float baumgarte = 0.2f;
+    static constexpr float allowedPenetration = 0.01f;
+    // Approach speed below which contacts don't bounce
+    static constexpr float restitutionThreshold = 1.0f;
+
+    ContactSolver() : iterations(8) {}
+
+    void setIterations(int count) {
+        iterations = count;
+    }
+
+    int getIterations() const {
+        return iterations;
+    }
+
+    // Builds one constraint per contact, picking up the impulses of the same body pair from
+    // the last step. Bodies that advance by more than stepTime this step list their time
+    // step in bodyStepTime, indexed by dense index for the first stepTimeCount bodies.
+    void prepare(const BodyStorage& bodies, const std::vector<Contact>& contacts, float stepTime,
+        const float* bodyStepTime = nullptr, size_t stepTimeCount = 0) {
+        constraints.resize(contacts.size());
+        numberPairContacts(bodies, contacts);
+        for (size_t i = 0; i < contacts.size(); ++i) {
+            const Contact& contact = contacts[i];
+            ContactConstraint& constraint = constraints[i];
+
+            // Pairs close the gap over the longer step of the two bodies
+            float deltaTime = stepTime;
+            if (contact.bodyA < stepTimeCount) {
+                deltaTime = std::max(deltaTime, bodyStepTime[contact.bodyA]);
+            }
+            if (contact.bodyB < stepTimeCount) {
+                deltaTime = std::max(deltaTime, bodyStepTime[contact.bodyB]);
+            }
+            constraint.bodyA = contact.bodyA;
+            constraint.bodyB = contact.bodyB;
+            constraint.normal = contact.normal;
+            constraint.inverseMassA = bodies.inverseMass[contact.bodyA];
+            constraint.inverseMassB = bodies.inverseMass[contact.bodyB];
+            constraint.effectiveMass = 1.0f / (constraint.inverseMassA + constraint.inverseMassB);
+
+            // Same material response as the old per pair resolvers
+            float restitution = contact.type == ContactType::SphereSphere ? 0.5f : 0.1f;
+            constraint.friction = contact.type == ContactType::SphereSphere ? 0.0f : 0.05f;
+
+            glm::vec3 relativeVelocity = bodies.getVelocity(contact.bodyB) - bodies.getVelocity(contact.bodyA);
+            float normalVelocity = glm::dot(relativeVelocity, contact.normal);
+            if (contact.depth < 0.0f) {
+                constraint.bias = contact.depth / deltaTime;
+            }
+            else {
+                float bounce = normalVelocity < -restitutionThreshold ? -restitution * normalVelocity : 0.0f;
+                float recovery = baumgarte / deltaTime * std::max(contact.depth - allowedPenetration, 0.0f);
+                constraint.bias = std::max(bounce, recovery);
+            }
+
+            constraint.normalImpulse = 0.0f;
+            constraint.tangentImpulse = glm::vec3(0.0f);
+
+            uint32_t handleA = bodies.handles[contact.bodyA];
+            uint32_t handleB = bodies.handles[contact.bodyB];
+            const ContactManifold* manifold = findManifold(pairKey(handleA, handleB), constraint.feature);
+            if (manifold) {
+                constraint.normalImpulse = manifold->normalImpulse;
+                // The tangent impulse is stored from A to B, flip it if the pair got swapped
+                constraint.tangentImpulse = manifold->handleA == handleA ? manifold->tangentImpulse : -manifold->tangentImpulse;
+                // Drop the part that points along the new normal
+                constraint.tangentImpulse -= glm::dot(constraint.tangentImpulse, constraint.normal) * constraint.normal;
+            }
+        }
+    }
+
+    // Warm starts and iterates the constraints listed in order. Groups of constraints that
+    // share no dynamic body can be solved at the same time, static bodies are never written.
+    void solve(BodyStorage& bodies, const uint32_t* order, uint32_t count) {
+        for (uint32_t i = 0; i < count; ++i) {
+            const ContactConstraint& constraint = constraints[order[i]];
+            applyImpulse(bodies, constraint, constraint.normalImpulse * constraint.normal + constraint.tangentImpulse);
+        }
+
+        for (int iteration = 0; iteration < iterations; ++iteration) {
+            for (uint32_t i = 0; i < count; ++i) {
+                solveConstraint(bodies, constraints[order[i]]);
+            }
+        }
+    }
+
+    // Keeps the impulses of this step for the next one. Manifolds of pairs that are asleep
+    // produce no contacts, those are carried over unchanged so they wake up warm. The same
+    // goes for pairs with a body whose bodyStepTime is 0, which skipped this step.
+    void storeImpulses(const BodyStorage& bodies, const std::vector<uint32_t>& handleToIndex, uint32_t awakeCount,
+        const float* bodyStepTime = nullptr, size_t stepTimeCount = 0) {
+        nextManifolds.clear();
+        for (size_t i = 0; i < manifolds.size(); ++i) {
+            uint32_t handleA = (uint32_t)(manifolds[i].key >> 32);
+            uint32_t handleB = (uint32_t)manifolds[i].key;
+            uint32_t a = handleA < handleToIndex.size() ? handleToIndex[handleA] : 0xFFFFFFFFu;
+            uint32_t b = handleB < handleToIndex.size() ? handleToIndex[handleB] : 0xFFFFFFFFu;
+            if (a == 0xFFFFFFFFu || b == 0xFFFFFFFFu) {
+                continue;
+            }
+            bool skipped = (a < stepTimeCount && bodyStepTime[a] == 0.0f) || (b < stepTimeCount && bodyStepTime[b] == 0.0f);
+            if ((a >= awakeCount && b >= awakeCount) || skipped) {
+                nextManifolds.push_back(manifolds[i]);
+            }
+        }
+
+        for (size_t i = 0; i < constraints.size(); ++i) {
+            const ContactConstraint& constraint = constraints[i];
+            ContactManifold manifold;
+            manifold.handleA = bodies.handles[constraint.bodyA];
+            manifold.key = pairKey(manifold.handleA, bodies.handles[constraint.bodyB]);
+            manifold.feature = constraint.feature;
+            manifold.normalImpulse = constraint.normalImpulse;
+            manifold.tangentImpulse = constraint.tangentImpulse;
+            nextManifolds.push_back(manifold);
+        }
+
+        std::sort(nextManifolds.begin(), nextManifolds.end());
+        manifolds.swap(nextManifolds);
+    }
+
+    const std::vector<ContactManifold>& getManifolds() const {
+        return manifolds;
+    }
+
+private:
+    int iterations;
+    std::vector<ContactConstraint> constraints;
+    // Sorted by key
+    std::vector<ContactManifold> manifolds;
+    std::vector<ContactManifold> nextManifolds;
+    // Pair key and contact index of every contact, sorted to number the contacts of a pair
+    std::vector<std::pair<uint64_t, uint32_t>> pairContacts;
+
+    static uint64_t pairKey(uint32_t handleA, uint32_t handleB) {
+        return ((uint64_t)std::min(handleA, handleB) << 32) | std::max(handleA, handleB);
+    }
+
+    const ContactManifold* findManifold(uint64_t key, uint32_t feature) const {
+        ContactManifold probe;
+        probe.key = key;
+        probe.feature = feature;
+        std::vector<ContactManifold>::const_iterator it = std::lower_bound(manifolds.begin(), manifolds.end(), probe);
+        return it != manifolds.end() && it->key == key && it->feature == feature ? &*it : nullptr;
+    }
+
+    // Numbers the contacts of each pair in the order the narrowphase produced them, which
+    // is the same from step to step while the pair keeps touching the same way
+    void numberPairContacts(const BodyStorage& bodies, const std::vector<Contact>& contacts) {
+        pairContacts.resize(contacts.size());
+        for (size_t i = 0; i < contacts.size(); ++i) {
+            pairContacts[i] = std::make_pair(pairKey(bodies.handles[contacts[i].bodyA], bodies.handles[contacts[i].bodyB]), (uint32_t)i);
+        }
+        std::sort(pairContacts.begin(), pairContacts.end());
+        for (size_t i = 0; i < pairContacts.size(); ++i) {
+            bool samePair = i > 0 && pairContacts[i].first == pairContacts[i - 1].first;
+            constraints[pairContacts[i].second].feature = samePair ? constraints[pairContacts[i - 1].second].feature + 1 : 0;
+        }
+    }
+
+    // Pushes A against and B along the impulse
+    static void applyImpulse(BodyStorage& bodies, const ContactConstraint& constraint, const glm::vec3& impulse) {
+        if (constraint.inverseMassA > 0.0f) {
+            bodies.setVelocity(constraint.bodyA, bodies.getVelocity(constraint.bodyA) - impulse * constraint.inverseMassA);
+        }
+        if (constraint.inverseMassB > 0.0f) {
+            bodies.setVelocity(constraint.bodyB, bodies.getVelocity(constraint.bodyB) + impulse * constraint.inverseMassB);
+        }
+    }
+
+    static void solveConstraint(BodyStorage& bodies, ContactConstraint& constraint) {
+        // Friction, limited by the normal impulse of the previous iteration
+        glm::vec3 relativeVelocity = bodies.getVelocity(constraint.bodyB) - bodies.getVelocity(constraint.bodyA);
+        glm::vec3 tangentVelocity = relativeVelocity - glm::dot(relativeVelocity, constraint.normal) * constraint.normal;
+        glm::vec3 oldTangentImpulse = constraint.tangentImpulse;
+        glm::vec3 tangentImpulse = oldTangentImpulse - tangentVelocity * constraint.effectiveMass;
+        float maxFriction = constraint.friction * constraint.normalImpulse;
+        float tangentLength = glm::length(tangentImpulse);
+        if (tangentLength > maxFriction) {
+            tangentImpulse *= tangentLength > 0.0f ? maxFriction / tangentLength : 0.0f;
+        }
+        constraint.tangentImpulse = tangentImpulse;
+        applyImpulse(bodies, constraint, tangentImpulse - oldTangentImpulse);
+
+        // Non penetration, the accumulated impulse may only push
+        relativeVelocity = bodies.getVelocity(constraint.bodyB) - bodies.getVelocity(constraint.bodyA);
+        float normalVelocity = glm::dot(relativeVelocity, constraint.normal);
+        float lambda = constraint.effectiveMass * (constraint.bias - normalVelocity);
+        float oldNormalImpulse = constraint.normalImpulse;
+        constraint.normalImpulse = std::max(oldNormalImpulse + lambda, 0.0f);
+        applyImpulse(bodies, constraint, (constraint.normalImpulse - oldNormalImpulse) * constraint.normal);
+    }
+};
+
+#endif
@@ -0,0 +1,408 @@
+#ifndef DYNAMIC_TREE_H
+#define DYNAMIC_TREE_H
+
+#include <glm/glm.hpp>
+#include <AABB.h>
+
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+// Incremental bounding volume tree. Leaves store fattened AABBs so a body only has to be
+// reinserted once it leaves its fat box, and the tree is kept balanced with rotations.
+// Handles big static boxes and small moving spheres equally well, unlike a uniform grid.
+class DynamicTree {
+public:
+    static constexpr int32_t nullNode = -1;
+
+    DynamicTree(float initialMargin = 0.1f, float initialDisplacementMultiplier = 2.0f)
+        : root(nullNode), freeList(nullNode), nodeCount(0),
+        margin(initialMargin), displacementMultiplier(initialDisplacementMultiplier) {}
+
+    // Room for count proxies, a tree of them has count - 1 inner nodes
+    void reserve(size_t count) {
+        nodes.reserve(count * 2);
+    }
+
+    // Creates a leaf for the box and returns its proxy id
+    int32_t createProxy(const AABB& box, uint32_t userData) {
+        int32_t proxy = allocateNode();
+        nodes[proxy].box = AABB(box.min - glm::vec3(margin), box.max + glm::vec3(margin));
+        nodes[proxy].userData = userData;
+        nodes[proxy].height = 0;
+        insertLeaf(proxy);
+        return proxy;
+    }
+
+    void destroyProxy(int32_t proxy) {
+        removeLeaf(proxy);
+        freeNode(proxy);
+    }
+
+    // Refits the proxy only when the box has left its fat AABB. The fat box is extended along
+    // the displacement so fast bodies don't have to be reinserted every step.
+    // Returns true if the proxy was reinserted.
+    bool moveProxy(int32_t proxy, const AABB& box, const glm::vec3& displacement) {
+        const AABB& fatBox = nodes[proxy].box;
+        if (contains(fatBox, box)) {
+            return false;
+        }
+
+        AABB newBox(box.min - glm::vec3(margin), box.max + glm::vec3(margin));
+        glm::vec3 extension = displacementMultiplier * displacement;
+        newBox.min += glm::min(extension, glm::vec3(0.0f));
+        newBox.max += glm::max(extension, glm::vec3(0.0f));
+
+        removeLeaf(proxy);
+        nodes[proxy].box = newBox;
+        insertLeaf(proxy);
+        return true;
+    }
+
+    const AABB& getFatAABB(int32_t proxy) const {
+        return nodes[proxy].box;
+    }
+
+    uint32_t getUserData(int32_t proxy) const {
+        return nodes[proxy].userData;
+    }
+
+    int32_t getHeight() const {
+        return root == nullNode ? 0 : nodes[root].height;
+    }
+
+    // Calls callback(proxy) for every leaf overlapping the box. Returning false stops the query.
+    template <typename Callback>
+    void query(const AABB& box, Callback callback) const {
+        std::vector<int32_t>& stack = queryStack;
+        stack.clear();
+        stack.push_back(root);
+
+        while (!stack.empty()) {
+            int32_t nodeId = stack.back();
+            stack.pop_back();
+            if (nodeId == nullNode) {
+                continue;
+            }
+
+            const TreeNode& node = nodes[nodeId];
+            if (!node.box.overlaps(box)) {
+                continue;
+            }
+
+            if (node.isLeaf()) {
+                if (!callback(nodeId)) {
+                    return;
+                }
+            }
+            else {
+                stack.push_back(node.child1);
+                stack.push_back(node.child2);
+            }
+        }
+    }
+
+    // Walks the leaves hit by the ray in [0, maxDistance]. callback(proxy, maxDistance) returns the
+    // new max distance: 0 stops the cast, a smaller value clips the ray, maxDistance keeps going.
+    template <typename Callback>
+    void raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, Callback callback) const {
+        sphereCast(origin, direction, 0.0f, maxDistance, callback);
+    }
+
+    // Same as raycast for a sphere of the radius, every node box is grown by it
+    template <typename Callback>
+    void sphereCast(const glm::vec3& origin, const glm::vec3& direction, float radius, float maxDistance, Callback callback) const {
+        glm::vec3 inverseDirection = rayInverseDirection(direction);
+        glm::vec3 grow(radius);
+
+        std::vector<int32_t>& stack = queryStack;
+        stack.clear();
+        stack.push_back(root);
+
+        while (!stack.empty()) {
+            int32_t nodeId = stack.back();
+            stack.pop_back();
+            if (nodeId == nullNode) {
+                continue;
+            }
+
+            const TreeNode& node = nodes[nodeId];
+            if (!rayHitsBox(origin, inverseDirection, maxDistance, AABB(node.box.min - grow, node.box.max + grow))) {
+                continue;
+            }
+
+            if (node.isLeaf()) {
+                float value = callback(nodeId, maxDistance);
+                if (value == 0.0f) {
+                    return;
+                }
+                maxDistance = value;
+            }
+            else {
+                stack.push_back(node.child1);
+                stack.push_back(node.child2);
+            }
+        }
+    }
+
+    // Slab test of a ray against a box, used for tree traversal
+    static bool rayHitsBox(const glm::vec3& origin, const glm::vec3& inverseDirection, float maxDistance, const AABB& box) {
+        glm::vec3 t1 = (box.min - origin) * inverseDirection;
+        glm::vec3 t2 = (box.max - origin) * inverseDirection;
+        glm::vec3 tMin = glm::min(t1, t2);
+        glm::vec3 tMax = glm::max(t1, t2);
+
+        float enter = std::max(std::max(tMin.x, tMin.y), std::max(tMin.z, 0.0f));
+        float exit = std::min(std::min(tMax.x, tMax.y), std::min(tMax.z, maxDistance));
+        return enter <= exit;
+    }
+
+private:
+    struct TreeNode {
+        AABB box;
+        uint32_t userData;
+        // Parent while in the tree, next free node while in the free list
+        int32_t parent;
+        int32_t child1;
+        int32_t child2;
+        // Leaf = 0, free node = -1
+        int32_t height;
+
+        bool isLeaf() const {
+            return child1 == nullNode;
+        }
+    };
+
+    std::vector<TreeNode> nodes;
+    int32_t root;
+    int32_t freeList;
+    int32_t nodeCount;
+    float margin;
+    float displacementMultiplier;
+    mutable std::vector<int32_t> queryStack;
+
+    static bool contains(const AABB& outer, const AABB& inner) {
+        return outer.min.x <= inner.min.x && outer.min.y <= inner.min.y && outer.min.z <= inner.min.z &&
+            inner.max.x <= outer.max.x && inner.max.y <= outer.max.y && inner.max.z <= outer.max.z;
+    }
+
+    static AABB combine(const AABB& a, const AABB& b) {
+        return AABB(glm::min(a.min, b.min), glm::max(a.max, b.max));
+    }
+
+    static float surfaceArea(const AABB& box) {
+        glm::vec3 d = box.max - box.min;
+        return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+    }
+
+    int32_t allocateNode() {
+        if (freeList == nullNode) {
+            TreeNode node;
+            node.parent = nullNode;
+            node.height = -1;
+            nodes.push_back(node);
+            freeList = (int32_t)nodes.size() - 1;
+            nodes[freeList].parent = nullNode;
+        }
+
+        int32_t nodeId = freeList;
+        freeList = nodes[nodeId].parent;
+        nodes[nodeId].parent = nullNode;
+        nodes[nodeId].child1 = nullNode;
+        nodes[nodeId].child2 = nullNode;
+        nodes[nodeId].height = 0;
+        nodes[nodeId].userData = 0;
+        ++nodeCount;
+        return nodeId;
+    }
+
+    void freeNode(int32_t nodeId) {
+        nodes[nodeId].parent = freeList;
+        nodes[nodeId].height = -1;
+        freeList = nodeId;
+        --nodeCount;
+    }
+
+    void insertLeaf(int32_t leaf) {
+        if (root == nullNode) {
+            root = leaf;
+            nodes[root].parent = nullNode;
+            return;
+        }
+
+        // Find the best sibling by walking down the cheapest branch (surface area heuristic)
+        AABB leafBox = nodes[leaf].box;
+        int32_t index = root;
+        while (!nodes[index].isLeaf()) {
+            int32_t child1 = nodes[index].child1;
+            int32_t child2 = nodes[index].child2;
+
+            float area = surfaceArea(nodes[index].box);
+            float combinedArea = surfaceArea(combine(nodes[index].box, leafBox));
+
+            // Cost of creating a new parent for this node and the new leaf
+            float cost = 2.0f * combinedArea;
+            // Minimum cost of pushing the leaf further down the tree
+            float inheritanceCost = 2.0f * (combinedArea - area);
+
+            float cost1 = childCost(child1, leafBox) + inheritanceCost;
+            float cost2 = childCost(child2, leafBox) + inheritanceCost;
+
+            if (cost < cost1 && cost < cost2) {
+                break;
+            }
+            index = cost1 < cost2 ? child1 : child2;
+        }
+
+        int32_t sibling = index;
+
+        // Create a new parent
+        int32_t oldParent = nodes[sibling].parent;
+        int32_t newParent = allocateNode();
+        nodes[newParent].parent = oldParent;
+        nodes[newParent].box = combine(leafBox, nodes[sibling].box);
+        nodes[newParent].height = nodes[sibling].height + 1;
+
+        if (oldParent != nullNode) {
+            if (nodes[oldParent].child1 == sibling) {
+                nodes[oldParent].child1 = newParent;
+            }
+            else {
+                nodes[oldParent].child2 = newParent;
+            }
+        }
+        else {
+            root = newParent;
+        }
+        nodes[newParent].child1 = sibling;
+        nodes[newParent].child2 = leaf;
+        nodes[sibling].parent = newParent;
+        nodes[leaf].parent = newParent;
+
+        // Walk back up the tree fixing heights and boxes
+        refitAncestors(nodes[leaf].parent);
+    }
+
+    float childCost(int32_t child, const AABB& leafBox) const {
+        AABB box = combine(leafBox, nodes[child].box);
+        if (nodes[child].isLeaf()) {
+            return surfaceArea(box);
+        }
+        return surfaceArea(box) - surfaceArea(nodes[child].box);
+    }
+
+    void removeLeaf(int32_t leaf) {
+        if (leaf == root) {
+            root = nullNode;
+            return;
+        }
+
+        int32_t parent = nodes[leaf].parent;
+        int32_t grandParent = nodes[parent].parent;
+        int32_t sibling = nodes[parent].child1 == leaf ? nodes[parent].child2 : nodes[parent].child1;
+
+        if (grandParent != nullNode) {
+            // Destroy the parent and connect the sibling to the grand parent
+            if (nodes[grandParent].child1 == parent) {
+                nodes[grandParent].child1 = sibling;
+            }
+            else {
+                nodes[grandParent].child2 = sibling;
+            }
+            nodes[sibling].parent = grandParent;
+            freeNode(parent);
+
+            refitAncestors(grandParent);
+        }
+        else {
+            root = sibling;
+            nodes[sibling].parent = nullNode;
+            freeNode(parent);
+        }
+    }
+
+    void refitAncestors(int32_t index) {
+        while (index != nullNode) {
+            index = balance(index);
+
+            int32_t child1 = nodes[index].child1;
+            int32_t child2 = nodes[index].child2;
+            nodes[index].height = 1 + std::max(nodes[child1].height, nodes[child2].height);
+            nodes[index].box = combine(nodes[child1].box, nodes[child2].box);
+
+            index = nodes[index].parent;
+        }
+    }
+
+    // Performs a left or right rotation if node A is imbalanced. Returns the new root of the subtree.
+    int32_t balance(int32_t iA) {
+        TreeNode* A = &nodes[iA];
+        if (A->isLeaf() || A->height < 2) {
+            return iA;
+        }
+
+        int32_t iB = A->child1;
+        int32_t iC = A->child2;
+        int32_t heightBalance = nodes[iC].height - nodes[iB].height;
+
+        // Rotate C up
+        if (heightBalance > 1) {
+            return rotateUp(iA, iC, iB);
+        }
+
+        // Rotate B up
+        if (heightBalance < -1) {
+            return rotateUp(iA, iB, iC);
+        }
+
+        return iA;
+    }
+
+    // Swaps A with its taller child, which takes over A's place in the tree
+    int32_t rotateUp(int32_t iA, int32_t iTall, int32_t iShort) {
+        TreeNode& A = nodes[iA];
+        TreeNode& tall = nodes[iTall];
+        int32_t iF = tall.child1;
+        int32_t iG = tall.child2;
+        TreeNode& F = nodes[iF];
+        TreeNode& G = nodes[iG];
+
+        tall.child1 = iA;
+        tall.parent = A.parent;
+        A.parent = iTall;
+
+        if (tall.parent != nullNode) {
+            if (nodes[tall.parent].child1 == iA) {
+                nodes[tall.parent].child1 = iTall;
+            }
+            else {
+                nodes[tall.parent].child2 = iTall;
+            }
+        }
+        else {
+            root = iTall;
+        }
+
+        // The taller grandchild stays under the rotated node, the other one moves under A
+        bool tallWasChild2 = A.child2 == iTall;
+        int32_t iKeep = F.height > G.height ? iF : iG;
+        int32_t iMove = F.height > G.height ? iG : iF;
+        tall.child2 = iKeep;
+        if (tallWasChild2) {
+            A.child2 = iMove;
+        }
+        else {
+            A.child1 = iMove;
+        }
+        nodes[iMove].parent = iA;
+
+        A.box = combine(nodes[iShort].box, nodes[iMove].box);
+        tall.box = combine(A.box, nodes[iKeep].box);
+        A.height = 1 + std::max(nodes[iShort].height, nodes[iMove].height);
+        tall.height = 1 + std::max(A.height, nodes[iKeep].height);
+
+        return iTall;
+    }
+};
+
+#endif
@@ -0,0 +1,178 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <memory>
+#include <cstdint>
+
+// Small work stealing thread pool. Every worker owns a queue and takes jobs from its back,
+// idle workers steal from the front of the other queues. The thread calling parallelFor
+// works on the jobs too, so a pool with zero workers simply runs everything inline.
+class JobSystem {
+public:
+    JobSystem(unsigned workerCount = defaultWorkerCount()) : running(true), pendingJobs(0) {
+        // Queue 0 belongs to the thread calling parallelFor
+        for (unsigned i = 0; i < workerCount + 1; ++i) {
+            queues.push_back(std::unique_ptr<WorkQueue>(new WorkQueue()));
+        }
+        for (unsigned i = 0; i < workerCount; ++i) {
+            workers.push_back(std::thread(&JobSystem::workerLoop, this, i + 1));
+        }
+    }
+
+    ~JobSystem() {
+        {
+            std::lock_guard<std::mutex> lock(wakeMutex);
+            running = false;
+        }
+        wakeCondition.notify_all();
+        for (size_t i = 0; i < workers.size(); ++i) {
+            workers[i].join();
+        }
+    }
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    static unsigned defaultWorkerCount() {
+        unsigned cores = std::thread::hardware_concurrency();
+        return cores > 1 ? cores - 1 : 0;
+    }
+
+    unsigned getWorkerCount() const {
+        return (unsigned)workers.size();
+    }
+
+    // Calls function(begin, end) over [0, count) split into chunks of grainSize and
+    // returns once every chunk has run
+    template <typename Function>
+    void parallelFor(uint32_t count, uint32_t grainSize, Function& function) {
+        if (count == 0) {
+            return;
+        }
+        if (workers.empty() || count <= grainSize) {
+            function(0u, count);
+            return;
+        }
+
+        std::atomic<uint32_t> remaining(0);
+        uint32_t jobCount = (count + grainSize - 1) / grainSize;
+        remaining = jobCount;
+
+        // Spread the chunks round robin so every worker starts with local work
+        for (uint32_t job = 0; job < jobCount; ++job) {
+            Job newJob;
+            newJob.run = &invoke<Function>;
+            newJob.context = &function;
+            newJob.begin = job * grainSize;
+            newJob.end = std::min(count, newJob.begin + grainSize);
+            newJob.remaining = &remaining;
+
+            WorkQueue& queue = *queues[job % queues.size()];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            queue.jobs.push_back(newJob);
+        }
+        {
+            std::lock_guard<std::mutex> lock(wakeMutex);
+            pendingJobs += jobCount;
+        }
+        wakeCondition.notify_all();
+
+        // Help out until every chunk of this call is done
+        while (remaining.load(std::memory_order_acquire) != 0) {
+            Job job;
+            if (takeJob(0, job)) {
+                execute(job);
+            }
+            else {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+private:
+    struct Job {
+        void (*run)(void* context, uint32_t begin, uint32_t end);
+        void* context;
+        uint32_t begin;
+        uint32_t end;
+        std::atomic<uint32_t>* remaining;
+    };
+
+    struct WorkQueue {
+        std::mutex mutex;
+        std::deque<Job> jobs;
+    };
+
+    std::vector<std::unique_ptr<WorkQueue>> queues;
+    std::vector<std::thread> workers;
+    std::mutex wakeMutex;
+    std::condition_variable wakeCondition;
+    bool running;
+    uint32_t pendingJobs;
+
+    template <typename Function>
+    static void invoke(void* context, uint32_t begin, uint32_t end) {
+        (*static_cast<Function*>(context))(begin, end);
+    }
+
+    void execute(Job& job) {
+        job.run(job.context, job.begin, job.end);
+        job.remaining->fetch_sub(1, std::memory_order_release);
+    }
+
+    // Pops from the back of our own queue, otherwise steals from the front of another one
+    bool takeJob(size_t owner, Job& job) {
+        {
+            WorkQueue& queue = *queues[owner];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (!queue.jobs.empty()) {
+                job = queue.jobs.back();
+                queue.jobs.pop_back();
+                onJobTaken();
+                return true;
+            }
+        }
+
+        for (size_t i = 1; i < queues.size(); ++i) {
+            WorkQueue& queue = *queues[(owner + i) % queues.size()];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (!queue.jobs.empty()) {
+                job = queue.jobs.front();
+                queue.jobs.pop_front();
+                onJobTaken();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void onJobTaken() {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        --pendingJobs;
+    }
+
+    void workerLoop(size_t index) {
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(wakeMutex);
+                wakeCondition.wait(lock, [this]() { return !running || pendingJobs > 0; });
+                if (!running) {
+                    return;
+                }
+            }
+
+            Job job;
+            while (takeJob(index, job)) {
+                execute(job);
+            }
+        }
+    }
+};
+
+#endif
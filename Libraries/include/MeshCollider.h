@@ -0,0 +1,470 @@
+#ifndef MESH_COLLIDER_H
+#define MESH_COLLIDER_H
+
+#include <glm/glm.hpp>
+#include <model.h>
+#include <AABB.h>
+
+#include <vector>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+
+// Contact of a sphere against a mesh, the normal points from the mesh towards the sphere
+struct MeshContact {
+    glm::vec3 normal;
+    float depth;
+    glm::vec3 point;
+};
+
+// Static triangle mesh with a bounding volume hierarchy baked once at load time. Nodes are
+// laid out depth first, the left child directly follows its parent, and store their bounds
+// quantized to 16 bits relative to the mesh bounds, so four nodes fit in a cache line.
+class MeshCollider {
+public:
+    static const int maxLeafTriangles = 4;
+
+    // Takes the triangles of every mesh in the model, moved into world space by transform
+    MeshCollider(const Model& model, const glm::mat4& transform = glm::mat4(1.0f)) {
+        for (size_t i = 0; i < model.meshes.size(); ++i) {
+            const Mesh& mesh = model.meshes[i];
+            for (size_t j = 0; j + 2 < mesh.indices.size(); j += 3) {
+                addTriangle(transform, mesh.vertices[mesh.indices[j]].Position,
+                    mesh.vertices[mesh.indices[j + 1]].Position, mesh.vertices[mesh.indices[j + 2]].Position);
+            }
+        }
+        build();
+    }
+
+    MeshCollider(const std::vector<glm::vec3>& vertices, const std::vector<unsigned int>& indices,
+        const glm::mat4& transform = glm::mat4(1.0f)) {
+        for (size_t j = 0; j + 2 < indices.size(); j += 3) {
+            addTriangle(transform, vertices[indices[j]], vertices[indices[j + 1]], vertices[indices[j + 2]]);
+        }
+        build();
+    }
+
+    const AABB& getBounds() const {
+        return bounds;
+    }
+
+    size_t getTriangleCount() const {
+        return triangles.size();
+    }
+
+    size_t getNodeCount() const {
+        return nodes.size();
+    }
+
+    // Closest triangle hit by the ray, direction must be normalized. Triangles are two sided,
+    // the normal faces against the ray.
+    bool raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, float& distance, glm::vec3& normal) const {
+        if (nodes.empty()) {
+            return false;
+        }
+
+        glm::vec3 inverseDirection = rayInverseDirection(direction);
+        bool found = false;
+        int32_t stack[maxDepth * 2];
+        int stackSize = 0;
+        stack[stackSize++] = 0;
+
+        while (stackSize > 0) {
+            const QuantizedNode& node = nodes[stack[--stackSize]];
+            if (!rayHitsBox(origin, inverseDirection, maxDistance, dequantize(node))) {
+                continue;
+            }
+
+            uint32_t count = node.data & 7u;
+            if (count > 0) {
+                uint32_t first = node.data >> 3;
+                for (uint32_t i = first; i < first + count; ++i) {
+                    float t;
+                    if (raycastTriangle(origin, direction, triangles[i], t) && t <= maxDistance) {
+                        maxDistance = t;
+                        distance = t;
+                        normal = faceNormal(triangles[i]);
+                        if (glm::dot(normal, direction) > 0.0f) {
+                            normal = -normal;
+                        }
+                        found = true;
+                    }
+                }
+            }
+            else {
+                uint32_t index = (uint32_t)(&node - &nodes[0]);
+                stack[stackSize++] = (int32_t)(node.data >> 3);
+                stack[stackSize++] = (int32_t)index + 1;
+            }
+        }
+        return found;
+    }
+
+    // Appends a contact for every triangle closer to the center than radius + margin. Triangles
+    // that give the same normal as an earlier contact, like neighbours sharing the edge the
+    // sphere rests on, are merged into the deeper one.
+    void collideSphere(const glm::vec3& center, float radius, float margin, std::vector<MeshContact>& contacts) const {
+        size_t firstContact = contacts.size();
+        float reach = radius + margin;
+        AABB sphereBounds(center - glm::vec3(reach), center + glm::vec3(reach));
+
+        forEachTriangle(sphereBounds, [&](const Triangle& triangle) {
+            glm::vec3 closest = closestPointOnTriangle(center, triangle);
+            glm::vec3 offset = center - closest;
+            float distanceSquared = glm::dot(offset, offset);
+            if (distanceSquared > reach * reach) {
+                return;
+            }
+
+            MeshContact contact;
+            float distance = std::sqrt(distanceSquared);
+            if (distance > 1e-6f) {
+                contact.normal = offset / distance;
+            }
+            else {
+                // Center on the triangle, push out along the face
+                contact.normal = faceNormal(triangle);
+            }
+            contact.depth = radius - distance;
+            contact.point = closest;
+
+            for (size_t i = firstContact; i < contacts.size(); ++i) {
+                if (glm::dot(contacts[i].normal, contact.normal) > 0.999f) {
+                    if (contact.depth > contacts[i].depth) {
+                        contacts[i] = contact;
+                    }
+                    return;
+                }
+            }
+            contacts.push_back(contact);
+        });
+    }
+
+    bool overlapsSphere(const glm::vec3& center, float radius) const {
+        bool overlaps = false;
+        AABB sphereBounds(center - glm::vec3(radius), center + glm::vec3(radius));
+        forEachTriangle(sphereBounds, [&](const Triangle& triangle) {
+            glm::vec3 offset = center - closestPointOnTriangle(center, triangle);
+            overlaps |= glm::dot(offset, offset) <= radius * radius;
+        });
+        return overlaps;
+    }
+
+private:
+    struct Triangle {
+        glm::vec3 a, b, c;
+    };
+
+    // Bounds relative to the mesh bounds in 1/65535 steps of its size. Leaves keep
+    // (first triangle << 3) | count in data, inner nodes (right child << 3).
+    struct QuantizedNode {
+        uint16_t min[3];
+        uint16_t max[3];
+        uint32_t data;
+    };
+
+    // Triangle bounds and centroid, only needed while building
+    struct BuildTriangle {
+        AABB box;
+        glm::vec3 centroid;
+        uint32_t index;
+    };
+
+    static const int binCount = 12;
+    // Deeper than this the build falls back to median splits, which bounds the traversal stacks
+    static const int maxDepth = 64;
+
+    std::vector<Triangle> triangles;
+    std::vector<QuantizedNode> nodes;
+    AABB bounds;
+    glm::vec3 quantizeScale;
+    glm::vec3 dequantizeScale;
+
+    void addTriangle(const glm::mat4& transform, const glm::vec3& a, const glm::vec3& b, const glm::vec3& c) {
+        Triangle triangle;
+        triangle.a = glm::vec3(transform * glm::vec4(a, 1.0f));
+        triangle.b = glm::vec3(transform * glm::vec4(b, 1.0f));
+        triangle.c = glm::vec3(transform * glm::vec4(c, 1.0f));
+        triangles.push_back(triangle);
+    }
+
+    void build() {
+        if (triangles.empty()) {
+            return;
+        }
+
+        std::vector<BuildTriangle> buildTriangles(triangles.size());
+        bounds = AABB(triangles[0].a, triangles[0].a);
+        for (size_t i = 0; i < triangles.size(); ++i) {
+            const Triangle& triangle = triangles[i];
+            BuildTriangle& buildTriangle = buildTriangles[i];
+            buildTriangle.box = AABB(glm::min(glm::min(triangle.a, triangle.b), triangle.c), glm::max(glm::max(triangle.a, triangle.b), triangle.c));
+            buildTriangle.centroid = (buildTriangle.box.min + buildTriangle.box.max) * 0.5f;
+            buildTriangle.index = (uint32_t)i;
+            bounds = combine(bounds, buildTriangle.box);
+        }
+
+        glm::vec3 size = bounds.max - bounds.min;
+        for (int axis = 0; axis < 3; ++axis) {
+            quantizeScale[axis] = size[axis] > 0.0f ? 65535.0f / size[axis] : 0.0f;
+            dequantizeScale[axis] = size[axis] / 65535.0f;
+        }
+
+        nodes.reserve(2 * triangles.size() / maxLeafTriangles + 1);
+        buildNode(buildTriangles, 0, (uint32_t)buildTriangles.size(), 0);
+
+        // Store the triangles in leaf order so each leaf reads one contiguous run
+        std::vector<Triangle> ordered(triangles.size());
+        for (size_t i = 0; i < buildTriangles.size(); ++i) {
+            ordered[i] = triangles[buildTriangles[i].index];
+        }
+        triangles.swap(ordered);
+    }
+
+    uint32_t buildNode(std::vector<BuildTriangle>& buildTriangles, uint32_t begin, uint32_t end, int depth) {
+        uint32_t index = (uint32_t)nodes.size();
+        nodes.push_back(QuantizedNode());
+
+        AABB box = buildTriangles[begin].box;
+        AABB centroidBox(buildTriangles[begin].centroid, buildTriangles[begin].centroid);
+        for (uint32_t i = begin + 1; i < end; ++i) {
+            box = combine(box, buildTriangles[i].box);
+            centroidBox = combine(centroidBox, AABB(buildTriangles[i].centroid, buildTriangles[i].centroid));
+        }
+        quantize(box, nodes[index]);
+
+        uint32_t count = end - begin;
+        if (count <= (uint32_t)maxLeafTriangles) {
+            nodes[index].data = (begin << 3) | count;
+            return index;
+        }
+
+        uint32_t middle = depth < maxDepth ? findSplit(buildTriangles, begin, end, centroidBox) : begin + count / 2;
+        buildNode(buildTriangles, begin, middle, depth + 1);
+        uint32_t right = buildNode(buildTriangles, middle, end, depth + 1);
+        nodes[index].data = right << 3;
+        return index;
+    }
+
+    // Binned surface area heuristic over all three axes. Partitions the range and returns
+    // where the right half starts, splits in the middle if all centroids coincide.
+    uint32_t findSplit(std::vector<BuildTriangle>& buildTriangles, uint32_t begin, uint32_t end, const AABB& centroidBox) {
+        float bestCost = 1e30f;
+        int bestAxis = -1;
+        int bestBin = 0;
+
+        for (int axis = 0; axis < 3; ++axis) {
+            float extent = centroidBox.max[axis] - centroidBox.min[axis];
+            if (extent <= 0.0f) {
+                continue;
+            }
+
+            AABB binBoxes[binCount];
+            uint32_t binCounts[binCount] = {};
+            float binScale = binCount / extent;
+            for (uint32_t i = begin; i < end; ++i) {
+                int bin = binOf(buildTriangles[i].centroid[axis], centroidBox.min[axis], binScale);
+                binBoxes[bin] = binCounts[bin] == 0 ? buildTriangles[i].box : combine(binBoxes[bin], buildTriangles[i].box);
+                ++binCounts[bin];
+            }
+
+            // Area and count of everything right of each split plane
+            float rightArea[binCount];
+            uint32_t rightCount[binCount];
+            AABB accumulated;
+            uint32_t accumulatedCount = 0;
+            for (int bin = binCount - 1; bin > 0; --bin) {
+                if (binCounts[bin] > 0) {
+                    accumulated = accumulatedCount == 0 ? binBoxes[bin] : combine(accumulated, binBoxes[bin]);
+                    accumulatedCount += binCounts[bin];
+                }
+                rightArea[bin] = accumulatedCount > 0 ? surfaceArea(accumulated) : 0.0f;
+                rightCount[bin] = accumulatedCount;
+            }
+
+            accumulatedCount = 0;
+            for (int bin = 0; bin < binCount - 1; ++bin) {
+                if (binCounts[bin] > 0) {
+                    accumulated = accumulatedCount == 0 ? binBoxes[bin] : combine(accumulated, binBoxes[bin]);
+                    accumulatedCount += binCounts[bin];
+                }
+                if (accumulatedCount == 0 || rightCount[bin + 1] == 0) {
+                    continue;
+                }
+
+                float cost = surfaceArea(accumulated) * accumulatedCount + rightArea[bin + 1] * rightCount[bin + 1];
+                if (cost < bestCost) {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestBin = bin;
+                }
+            }
+        }
+
+        if (bestAxis < 0) {
+            return begin + (end - begin) / 2;
+        }
+
+        float axisMin = centroidBox.min[bestAxis];
+        float binScale = binCount / (centroidBox.max[bestAxis] - axisMin);
+        BuildTriangle* middle = std::partition(&buildTriangles[begin], &buildTriangles[0] + end, [&](const BuildTriangle& triangle) {
+            return binOf(triangle.centroid[bestAxis], axisMin, binScale) <= bestBin;
+        });
+        return (uint32_t)(middle - &buildTriangles[0]);
+    }
+
+    static int binOf(float value, float axisMin, float binScale) {
+        return std::min((int)((value - axisMin) * binScale), binCount - 1);
+    }
+
+    // Rounds outwards so the quantized box always contains the real one
+    void quantize(const AABB& box, QuantizedNode& node) const {
+        for (int axis = 0; axis < 3; ++axis) {
+            float low = std::floor((box.min[axis] - bounds.min[axis]) * quantizeScale[axis]);
+            float high = std::ceil((box.max[axis] - bounds.min[axis]) * quantizeScale[axis]);
+            node.min[axis] = (uint16_t)std::min(std::max(low, 0.0f), 65535.0f);
+            node.max[axis] = (uint16_t)std::min(std::max(high, 0.0f), 65535.0f);
+        }
+    }
+
+    AABB dequantize(const QuantizedNode& node) const {
+        glm::vec3 low((float)node.min[0], (float)node.min[1], (float)node.min[2]);
+        glm::vec3 high((float)node.max[0], (float)node.max[1], (float)node.max[2]);
+        return AABB(bounds.min + low * dequantizeScale, bounds.min + high * dequantizeScale);
+    }
+
+    // Calls function(triangle) for every triangle in a leaf overlapping the box
+    template <typename Function>
+    void forEachTriangle(const AABB& box, Function function) const {
+        if (nodes.empty()) {
+            return;
+        }
+
+        int32_t stack[maxDepth * 2];
+        int stackSize = 0;
+        stack[stackSize++] = 0;
+
+        while (stackSize > 0) {
+            uint32_t index = (uint32_t)stack[--stackSize];
+            const QuantizedNode& node = nodes[index];
+            if (!dequantize(node).overlaps(box)) {
+                continue;
+            }
+
+            uint32_t count = node.data & 7u;
+            if (count > 0) {
+                uint32_t first = node.data >> 3;
+                for (uint32_t i = first; i < first + count; ++i) {
+                    function(triangles[i]);
+                }
+            }
+            else {
+                stack[stackSize++] = (int32_t)(node.data >> 3);
+                stack[stackSize++] = (int32_t)index + 1;
+            }
+        }
+    }
+
+    static AABB combine(const AABB& a, const AABB& b) {
+        return AABB(glm::min(a.min, b.min), glm::max(a.max, b.max));
+    }
+
+    static float surfaceArea(const AABB& box) {
+        glm::vec3 d = box.max - box.min;
+        return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+    }
+
+    static glm::vec3 faceNormal(const Triangle& triangle) {
+        glm::vec3 normal = glm::cross(triangle.b - triangle.a, triangle.c - triangle.a);
+        float length = glm::length(normal);
+        return length > 0.0f ? normal / length : glm::vec3(0.0f, 1.0f, 0.0f);
+    }
+
+    static bool rayHitsBox(const glm::vec3& origin, const glm::vec3& inverseDirection, float maxDistance, const AABB& box) {
+        glm::vec3 t1 = (box.min - origin) * inverseDirection;
+        glm::vec3 t2 = (box.max - origin) * inverseDirection;
+        glm::vec3 tMin = glm::min(t1, t2);
+        glm::vec3 tMax = glm::max(t1, t2);
+
+        float enter = std::max(std::max(tMin.x, tMin.y), std::max(tMin.z, 0.0f));
+        float exit = std::min(std::min(tMax.x, tMax.y), std::min(tMax.z, maxDistance));
+        return enter <= exit;
+    }
+
+    // Moller-Trumbore, hits from both sides
+    static bool raycastTriangle(const glm::vec3& origin, const glm::vec3& direction, const Triangle& triangle, float& distance) {
+        glm::vec3 edge1 = triangle.b - triangle.a;
+        glm::vec3 edge2 = triangle.c - triangle.a;
+        glm::vec3 p = glm::cross(direction, edge2);
+        float determinant = glm::dot(edge1, p);
+        if (std::abs(determinant) < 1e-12f) {
+            return false;
+        }
+
+        float inverse = 1.0f / determinant;
+        glm::vec3 toOrigin = origin - triangle.a;
+        float u = glm::dot(toOrigin, p) * inverse;
+        if (u < 0.0f || u > 1.0f) {
+            return false;
+        }
+
+        glm::vec3 q = glm::cross(toOrigin, edge1);
+        float v = glm::dot(direction, q) * inverse;
+        if (v < 0.0f || u + v > 1.0f) {
+            return false;
+        }
+
+        distance = glm::dot(edge2, q) * inverse;
+        return distance >= 0.0f;
+    }
+
+    // Closest point on the triangle by its Voronoi regions, from Real-Time Collision Detection
+    static glm::vec3 closestPointOnTriangle(const glm::vec3& point, const Triangle& triangle) {
+        const glm::vec3& a = triangle.a;
+        const glm::vec3& b = triangle.b;
+        const glm::vec3& c = triangle.c;
+        glm::vec3 ab = b - a;
+        glm::vec3 ac = c - a;
+
+        glm::vec3 ap = point - a;
+        float d1 = glm::dot(ab, ap);
+        float d2 = glm::dot(ac, ap);
+        if (d1 <= 0.0f && d2 <= 0.0f) {
+            return a;
+        }
+
+        glm::vec3 bp = point - b;
+        float d3 = glm::dot(ab, bp);
+        float d4 = glm::dot(ac, bp);
+        if (d3 >= 0.0f && d4 <= d3) {
+            return b;
+        }
+
+        float vc = d1 * d4 - d3 * d2;
+        if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) {
+            return a + ab * (d1 / (d1 - d3));
+        }
+
+        glm::vec3 cp = point - c;
+        float d5 = glm::dot(ab, cp);
+        float d6 = glm::dot(ac, cp);
+        if (d6 >= 0.0f && d5 <= d6) {
+            return c;
+        }
+
+        float vb = d5 * d2 - d1 * d6;
+        if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) {
+            return a + ac * (d2 / (d2 - d6));
+        }
+
+        float va = d3 * d6 - d5 * d4;
+        if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f) {
+            return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+        }
+
+        float denominator = 1.0f / (va + vb + vc);
+        return a + ab * (vb * denominator) + ac * (vc * denominator);
+    }
+};
+
+#endif
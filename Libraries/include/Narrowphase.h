@@ -0,0 +1,562 @@
+#ifndef NARROWPHASE_H
+#define NARROWPHASE_H
+
+#include <glm/glm.hpp>
+#include <PhysicsSimd.h>
+#include <OrientedBox.h>
+
+#include <vector>
+#include <cstdint>
+#include <cmath>
+
+enum class ContactType : uint8_t {
+    SphereSphere,
+    SphereBox,
+    SphereMesh,
+    BoxBox
+};
+
+// Result of a narrowphase test. The normal points from bodyA towards bodyB, for sphere vs
+// box contacts bodyA is the box and bodyB the sphere. A negative depth marks a speculative
+// contact, the bodies are still that far apart but may touch within the step.
+struct Contact {
+    uint32_t bodyA;
+    uint32_t bodyB;
+    glm::vec3 normal;
+    float depth;
+    glm::vec3 point;
+    ContactType type;
+};
+
+// Candidate sphere pairs packed one array per component, padded to the SIMD width.
+// Pairs closer than their margin get a speculative contact.
+struct SpherePairBatch {
+    std::vector<float> centerAX, centerAY, centerAZ, radiusA;
+    std::vector<float> centerBX, centerBY, centerBZ, radiusB;
+    std::vector<float> margin;
+    std::vector<uint32_t> bodyA, bodyB;
+
+    void clear() {
+        centerAX.clear(); centerAY.clear(); centerAZ.clear(); radiusA.clear();
+        centerBX.clear(); centerBY.clear(); centerBZ.clear(); radiusB.clear();
+        margin.clear();
+        bodyA.clear(); bodyB.clear();
+    }
+
+    size_t size() const {
+        return bodyA.size();
+    }
+
+    void add(uint32_t a, const glm::vec3& centerA, float sphereRadiusA, uint32_t b, const glm::vec3& centerB, float sphereRadiusB,
+        float speculativeMargin = 0.0f) {
+        centerAX.push_back(centerA.x); centerAY.push_back(centerA.y); centerAZ.push_back(centerA.z); radiusA.push_back(sphereRadiusA);
+        centerBX.push_back(centerB.x); centerBY.push_back(centerB.y); centerBZ.push_back(centerB.z); radiusB.push_back(sphereRadiusB);
+        margin.push_back(speculativeMargin);
+        bodyA.push_back(a);
+        bodyB.push_back(b);
+    }
+
+    // Fills the last register with pairs that can never touch
+    void pad() {
+        while (centerAX.size() % SimdFloat::width != 0) {
+            centerAX.push_back(0.0f); centerAY.push_back(0.0f); centerAZ.push_back(0.0f); radiusA.push_back(0.0f);
+            centerBX.push_back(1e18f); centerBY.push_back(0.0f); centerBZ.push_back(0.0f); radiusB.push_back(0.0f);
+            margin.push_back(0.0f);
+        }
+    }
+};
+
+// Candidate sphere vs box pairs, boxes are world space AABBs
+struct SphereBoxPairBatch {
+    std::vector<float> centerX, centerY, centerZ, radius;
+    std::vector<float> boxMinX, boxMinY, boxMinZ;
+    std::vector<float> boxMaxX, boxMaxY, boxMaxZ;
+    std::vector<float> margin;
+    std::vector<uint32_t> sphere, box;
+
+    void clear() {
+        centerX.clear(); centerY.clear(); centerZ.clear(); radius.clear();
+        boxMinX.clear(); boxMinY.clear(); boxMinZ.clear();
+        boxMaxX.clear(); boxMaxY.clear(); boxMaxZ.clear();
+        margin.clear();
+        sphere.clear(); box.clear();
+    }
+
+    size_t size() const {
+        return sphere.size();
+    }
+
+    void add(uint32_t sphereIndex, const glm::vec3& center, float sphereRadius, uint32_t boxIndex, const glm::vec3& boxMin, const glm::vec3& boxMax,
+        float speculativeMargin = 0.0f) {
+        centerX.push_back(center.x); centerY.push_back(center.y); centerZ.push_back(center.z); radius.push_back(sphereRadius);
+        boxMinX.push_back(boxMin.x); boxMinY.push_back(boxMin.y); boxMinZ.push_back(boxMin.z);
+        boxMaxX.push_back(boxMax.x); boxMaxY.push_back(boxMax.y); boxMaxZ.push_back(boxMax.z);
+        margin.push_back(speculativeMargin);
+        sphere.push_back(sphereIndex);
+        box.push_back(boxIndex);
+    }
+
+    void pad() {
+        while (centerX.size() % SimdFloat::width != 0) {
+            centerX.push_back(1e18f); centerY.push_back(0.0f); centerZ.push_back(0.0f); radius.push_back(0.0f);
+            boxMinX.push_back(0.0f); boxMinY.push_back(0.0f); boxMinZ.push_back(0.0f);
+            boxMaxX.push_back(0.0f); boxMaxY.push_back(0.0f); boxMaxZ.push_back(0.0f);
+            margin.push_back(0.0f);
+        }
+    }
+};
+
+// Candidate box pairs for the separating axis test. Every box is stored as center, half
+// extents and its three axes, axis aligned boxes simply have the world axes.
+struct BoxPairBatch {
+    std::vector<float> centerAX, centerAY, centerAZ, halfAX, halfAY, halfAZ;
+    std::vector<float> centerBX, centerBY, centerBZ, halfBX, halfBY, halfBZ;
+    // axisA[3 * i + j] holds component j of every pair's axis i
+    std::vector<float> axisA[9], axisB[9];
+    std::vector<float> margin;
+    std::vector<uint32_t> bodyA, bodyB;
+
+    void clear() {
+        centerAX.clear(); centerAY.clear(); centerAZ.clear(); halfAX.clear(); halfAY.clear(); halfAZ.clear();
+        centerBX.clear(); centerBY.clear(); centerBZ.clear(); halfBX.clear(); halfBY.clear(); halfBZ.clear();
+        for (int i = 0; i < 9; ++i) {
+            axisA[i].clear();
+            axisB[i].clear();
+        }
+        margin.clear();
+        bodyA.clear(); bodyB.clear();
+    }
+
+    size_t size() const {
+        return bodyA.size();
+    }
+
+    void add(uint32_t a, const OrientedBox& boxA, uint32_t b, const OrientedBox& boxB, float speculativeMargin = 0.0f) {
+        push(boxA, boxB, speculativeMargin);
+        bodyA.push_back(a);
+        bodyB.push_back(b);
+    }
+
+    // Fills the last register with pairs that are far apart
+    void pad() {
+        OrientedBox far;
+        far.center.x = 1e18f;
+        while (centerAX.size() % SimdFloat::width != 0) {
+            push(OrientedBox(), far, 0.0f);
+        }
+    }
+
+private:
+    void push(const OrientedBox& boxA, const OrientedBox& boxB, float speculativeMargin) {
+        centerAX.push_back(boxA.center.x); centerAY.push_back(boxA.center.y); centerAZ.push_back(boxA.center.z);
+        halfAX.push_back(boxA.halfExtents.x); halfAY.push_back(boxA.halfExtents.y); halfAZ.push_back(boxA.halfExtents.z);
+        centerBX.push_back(boxB.center.x); centerBY.push_back(boxB.center.y); centerBZ.push_back(boxB.center.z);
+        halfBX.push_back(boxB.halfExtents.x); halfBY.push_back(boxB.halfExtents.y); halfBZ.push_back(boxB.halfExtents.z);
+        for (int i = 0; i < 3; ++i) {
+            for (int j = 0; j < 3; ++j) {
+                axisA[3 * i + j].push_back(boxA.axes[i][j]);
+                axisB[3 * i + j].push_back(boxB.axes[i][j]);
+            }
+        }
+        margin.push_back(speculativeMargin);
+    }
+};
+
+// Outcome of the separating axis test of one box pair. Axes 0-2 are the axes of box A, 3-5
+// those of box B and 6-14 the cross products A[i] x B[j] at 6 + 3 * i + j. Separations are
+// signed distances along the axis, negative while the boxes overlap.
+struct BoxPairResult {
+    uint8_t axis;
+    bool separated;
+    float separation;
+    // How much closer the next best axis is, only kept for overlapping pairs
+    float gap;
+};
+
+// Batched contact generation. Each kernel tests SimdFloat::width pairs per iteration and
+// only touches scalar code for the pairs that actually overlap.
+class Narrowphase {
+public:
+    // Given separations, (*separations)[i] gets the distance between the surfaces of pair i,
+    // negative while they overlap
+    static void collideSpheres(SpherePairBatch& batch, std::vector<Contact>& contacts, std::vector<float>* separations = nullptr) {
+        const int width = SimdFloat::width;
+        size_t count = batch.size();
+        batch.pad();
+        if (separations) {
+            separations->resize(batch.centerAX.size());
+        }
+
+        float normalX[width], normalY[width], normalZ[width], depth[width], distance[width];
+
+        for (size_t i = 0; i < count; i += width) {
+            SimdFloat dx = SimdFloat::load(&batch.centerBX[i]) - SimdFloat::load(&batch.centerAX[i]);
+            SimdFloat dy = SimdFloat::load(&batch.centerBY[i]) - SimdFloat::load(&batch.centerAY[i]);
+            SimdFloat dz = SimdFloat::load(&batch.centerBZ[i]) - SimdFloat::load(&batch.centerAZ[i]);
+            SimdFloat combinedRadius = SimdFloat::load(&batch.radiusA[i]) + SimdFloat::load(&batch.radiusB[i]);
+            SimdFloat reach = combinedRadius + SimdFloat::load(&batch.margin[i]);
+
+            SimdFloat distanceSquared = dx * dx + dy * dy + dz * dz;
+            if (separations) {
+                (simdSqrt(distanceSquared) - combinedRadius).store(&(*separations)[i]);
+            }
+            int hits = simdMoveMask(simdLess(distanceSquared, reach * reach));
+            if (hits == 0) {
+                continue;
+            }
+
+            SimdFloat length = simdSqrt(distanceSquared);
+            // Coincident centers get an arbitrary up normal instead of a division by zero
+            SimdFloat safeLength = simdMax(length, SimdFloat(1e-6f));
+            SimdFloat inverseLength = SimdFloat(1.0f) / safeLength;
+            SimdFloat degenerate = simdLess(length, SimdFloat(1e-6f));
+            (dx * inverseLength).store(normalX);
+            simdSelect(degenerate, SimdFloat(1.0f), dy * inverseLength).store(normalY);
+            (dz * inverseLength).store(normalZ);
+            (combinedRadius - length).store(depth);
+            length.store(distance);
+
+            for (int lane = 0; lane < width; ++lane) {
+                if (!(hits & (1 << lane)) || i + lane >= count) {
+                    continue;
+                }
+
+                Contact contact;
+                contact.bodyA = batch.bodyA[i + lane];
+                contact.bodyB = batch.bodyB[i + lane];
+                contact.normal = glm::vec3(normalX[lane], normalY[lane], normalZ[lane]);
+                contact.depth = depth[lane];
+                glm::vec3 centerA(batch.centerAX[i + lane], batch.centerAY[i + lane], batch.centerAZ[i + lane]);
+                contact.point = centerA + contact.normal * batch.radiusA[i + lane];
+                contact.type = ContactType::SphereSphere;
+                contacts.push_back(contact);
+            }
+        }
+    }
+
+    // Separations like collideSpheres, from the sphere surface to the box
+    static void collideSphereBoxes(SphereBoxPairBatch& batch, std::vector<Contact>& contacts, std::vector<float>* separations = nullptr) {
+        const int width = SimdFloat::width;
+        size_t count = batch.size();
+        batch.pad();
+        if (separations) {
+            separations->resize(batch.centerX.size());
+        }
+
+        float closestX[width], closestY[width], closestZ[width], distance[width];
+
+        for (size_t i = 0; i < count; i += width) {
+            SimdFloat cx = SimdFloat::load(&batch.centerX[i]);
+            SimdFloat cy = SimdFloat::load(&batch.centerY[i]);
+            SimdFloat cz = SimdFloat::load(&batch.centerZ[i]);
+            SimdFloat r = SimdFloat::load(&batch.radius[i]);
+            SimdFloat reach = r + SimdFloat::load(&batch.margin[i]);
+
+            // Closest point on the box to the sphere center
+            SimdFloat px = simdMin(simdMax(cx, SimdFloat::load(&batch.boxMinX[i])), SimdFloat::load(&batch.boxMaxX[i]));
+            SimdFloat py = simdMin(simdMax(cy, SimdFloat::load(&batch.boxMinY[i])), SimdFloat::load(&batch.boxMaxY[i]));
+            SimdFloat pz = simdMin(simdMax(cz, SimdFloat::load(&batch.boxMinZ[i])), SimdFloat::load(&batch.boxMaxZ[i]));
+
+            SimdFloat dx = cx - px;
+            SimdFloat dy = cy - py;
+            SimdFloat dz = cz - pz;
+            SimdFloat distanceSquared = dx * dx + dy * dy + dz * dz;
+            if (separations) {
+                (simdSqrt(distanceSquared) - r).store(&(*separations)[i]);
+            }
+
+            int hits = simdMoveMask(simdLess(distanceSquared, reach * reach));
+            if (hits == 0) {
+                continue;
+            }
+
+            px.store(closestX);
+            py.store(closestY);
+            pz.store(closestZ);
+            simdSqrt(distanceSquared).store(distance);
+
+            for (int lane = 0; lane < width; ++lane) {
+                if (!(hits & (1 << lane)) || i + lane >= count) {
+                    continue;
+                }
+
+                size_t pair = i + lane;
+                glm::vec3 center(batch.centerX[pair], batch.centerY[pair], batch.centerZ[pair]);
+                glm::vec3 closest(closestX[lane], closestY[lane], closestZ[lane]);
+
+                Contact contact;
+                contact.bodyA = batch.box[pair];
+                contact.bodyB = batch.sphere[pair];
+                contact.type = ContactType::SphereBox;
+
+                if (distance[lane] > 1e-6f) {
+                    contact.normal = (center - closest) / distance[lane];
+                    contact.depth = batch.radius[pair] - distance[lane];
+                    contact.point = closest;
+                }
+                else {
+                    // Center inside the box, push out through the nearest face
+                    glm::vec3 boxMin(batch.boxMinX[pair], batch.boxMinY[pair], batch.boxMinZ[pair]);
+                    glm::vec3 boxMax(batch.boxMaxX[pair], batch.boxMaxY[pair], batch.boxMaxZ[pair]);
+                    insideBoxContact(center, batch.radius[pair], boxMin, boxMax, contact);
+                }
+                contacts.push_back(contact);
+            }
+        }
+    }
+
+    // Separating axis test of box pairs. The 15 axes are tested one after another for all
+    // pairs in a register at once, and a register stops as soon as every pair in it found an
+    // axis that separates it. Overlapping and speculative pairs get a single contact along
+    // the axis of least penetration, results[i] describes pair i for the caller's cache.
+    static void collideBoxes(BoxPairBatch& batch, std::vector<Contact>& contacts, std::vector<BoxPairResult>& results) {
+        const int width = SimdFloat::width;
+        size_t count = batch.size();
+        batch.pad();
+        results.resize(count);
+
+        const SimdFloat zero(0.0f);
+        // Keeps near parallel edge pairs from producing a zero axis
+        const SimdFloat epsilon(1e-6f);
+        const SimdFloat negativeInfinity(-1e30f);
+        float bestStore[width], bestAxisStore[width], secondStore[width], separatingAxisStore[width], separatingStore[width];
+
+        for (size_t i = 0; i < count; i += width) {
+            SimdFloat a[3][3], b[3][3];
+            for (int axis = 0; axis < 3; ++axis) {
+                for (int component = 0; component < 3; ++component) {
+                    a[axis][component] = SimdFloat::load(&batch.axisA[3 * axis + component][i]);
+                    b[axis][component] = SimdFloat::load(&batch.axisB[3 * axis + component][i]);
+                }
+            }
+            SimdFloat halfA[3] = { SimdFloat::load(&batch.halfAX[i]), SimdFloat::load(&batch.halfAY[i]), SimdFloat::load(&batch.halfAZ[i]) };
+            SimdFloat halfB[3] = { SimdFloat::load(&batch.halfBX[i]), SimdFloat::load(&batch.halfBY[i]), SimdFloat::load(&batch.halfBZ[i]) };
+            SimdFloat dx = SimdFloat::load(&batch.centerBX[i]) - SimdFloat::load(&batch.centerAX[i]);
+            SimdFloat dy = SimdFloat::load(&batch.centerBY[i]) - SimdFloat::load(&batch.centerAY[i]);
+            SimdFloat dz = SimdFloat::load(&batch.centerBZ[i]) - SimdFloat::load(&batch.centerAZ[i]);
+            SimdFloat margin = SimdFloat::load(&batch.margin[i]);
+
+            // B's axes and the center offset in A's frame
+            SimdFloat r[3][3], absR[3][3], t[3];
+            for (int row = 0; row < 3; ++row) {
+                for (int column = 0; column < 3; ++column) {
+                    r[row][column] = a[row][0] * b[column][0] + a[row][1] * b[column][1] + a[row][2] * b[column][2];
+                    absR[row][column] = simdAbs(r[row][column]) + epsilon;
+                }
+                t[row] = dx * a[row][0] + dy * a[row][1] + dz * a[row][2];
+            }
+
+            SimdFloat best = negativeInfinity;
+            SimdFloat second = negativeInfinity;
+            SimdFloat bestAxis = zero;
+            SimdFloat separated = simdLess(zero, zero);
+            SimdFloat separatingAxis = zero;
+            SimdFloat separating = zero;
+            int lanes = (int)std::min((size_t)width, count - i);
+            int laneMask = (1 << lanes) - 1;
+
+            for (int axis = 0; axis < 15; ++axis) {
+                SimdFloat separation = axisSeparation(axis, halfA, halfB, r, absR, t, negativeInfinity);
+
+                // Track the least penetrating axis and the runner up
+                SimdFloat better = simdGreater(separation, best);
+                second = simdSelect(better, best, simdMax(second, separation));
+                best = simdSelect(better, separation, best);
+                bestAxis = simdSelect(better, SimdFloat((float)axis), bestAxis);
+
+                SimdFloat newlySeparated = simdGreater(separation, margin) & simdSelect(separated, zero, simdLessEqual(zero, zero));
+                separatingAxis = simdSelect(newlySeparated, SimdFloat((float)axis), separatingAxis);
+                separating = simdSelect(newlySeparated, separation, separating);
+                separated = separated | newlySeparated;
+                if ((simdMoveMask(separated) & laneMask) == laneMask) {
+                    break;
+                }
+            }
+
+            int separatedLanes = simdMoveMask(separated);
+            best.store(bestStore);
+            bestAxis.store(bestAxisStore);
+            second.store(secondStore);
+            separatingAxis.store(separatingAxisStore);
+            separating.store(separatingStore);
+
+            for (int lane = 0; lane < lanes; ++lane) {
+                BoxPairResult& result = results[i + lane];
+                if (separatedLanes & (1 << lane)) {
+                    result.axis = (uint8_t)separatingAxisStore[lane];
+                    result.separated = true;
+                    result.separation = separatingStore[lane];
+                    result.gap = 0.0f;
+                    continue;
+                }
+
+                result.axis = (uint8_t)bestAxisStore[lane];
+                result.separated = false;
+                result.separation = bestStore[lane];
+                result.gap = bestStore[lane] - secondStore[lane];
+
+                size_t pair = i + lane;
+                OrientedBox boxA = batchBox(batch, pair, true);
+                OrientedBox boxB = batchBox(batch, pair, false);
+                contacts.push_back(boxContact(batch.bodyA[pair], boxA, batch.bodyB[pair], boxB, result.axis, result.separation));
+            }
+        }
+    }
+
+    // World direction of a separating axis, not normalized and not oriented
+    static glm::vec3 boxAxis(const OrientedBox& boxA, const OrientedBox& boxB, int axis) {
+        if (axis < 3) {
+            return boxA.axes[axis];
+        }
+        if (axis < 6) {
+            return boxB.axes[axis - 3];
+        }
+        return glm::cross(boxA.axes[(axis - 6) / 3], boxB.axes[(axis - 6) % 3]);
+    }
+
+    // Signed distance between the boxes along one axis. Returns false for edge axes of near
+    // parallel edges, which don't have a usable direction.
+    static bool boxSeparation(const OrientedBox& boxA, const OrientedBox& boxB, int axis, float& separation) {
+        glm::vec3 direction = boxAxis(boxA, boxB, axis);
+        float length = glm::length(direction);
+        if (length < 1e-3f) {
+            return false;
+        }
+        direction /= length;
+
+        float radiusA = 0.0f;
+        float radiusB = 0.0f;
+        for (int i = 0; i < 3; ++i) {
+            radiusA += boxA.halfExtents[i] * std::abs(glm::dot(boxA.axes[i], direction));
+            radiusB += boxB.halfExtents[i] * std::abs(glm::dot(boxB.axes[i], direction));
+        }
+        separation = std::abs(glm::dot(boxB.center - boxA.center, direction)) - radiusA - radiusB;
+        return true;
+    }
+
+    // Contact along a separating axis, the normal points from A to B
+    static Contact boxContact(uint32_t bodyA, const OrientedBox& boxA, uint32_t bodyB, const OrientedBox& boxB, int axis, float separation) {
+        glm::vec3 normal = glm::normalize(boxAxis(boxA, boxB, axis));
+        if (glm::dot(normal, boxB.center - boxA.center) < 0.0f) {
+            normal = -normal;
+        }
+
+        Contact contact;
+        contact.bodyA = bodyA;
+        contact.bodyB = bodyB;
+        contact.normal = normal;
+        contact.depth = -separation;
+        // Between the deepest corners of both boxes, the solver only needs a single point
+        contact.point = (boxA.support(normal) + boxB.support(-normal)) * 0.5f;
+        contact.type = ContactType::BoxBox;
+        return contact;
+    }
+
+    // Sphere against a box that may be turned, solved in the box frame
+    static bool collideSphereOrientedBox(uint32_t sphere, const glm::vec3& center, float radius, uint32_t box, const OrientedBox& orientedBox,
+        float margin, Contact& contact) {
+        glm::vec3 local = orientedBox.toLocal(center);
+        glm::vec3 closest = glm::clamp(local, -orientedBox.halfExtents, orientedBox.halfExtents);
+        glm::vec3 offset = local - closest;
+        float distanceSquared = glm::dot(offset, offset);
+        float reach = radius + margin;
+        if (distanceSquared >= reach * reach) {
+            return false;
+        }
+
+        contact.bodyA = box;
+        contact.bodyB = sphere;
+        contact.type = ContactType::SphereBox;
+
+        float distance = std::sqrt(distanceSquared);
+        if (distance > 1e-6f) {
+            contact.normal = offset / distance;
+            contact.depth = radius - distance;
+            contact.point = closest;
+        }
+        else {
+            insideBoxContact(local, radius, -orientedBox.halfExtents, orientedBox.halfExtents, contact);
+        }
+        contact.normal = orientedBox.toWorldDirection(contact.normal);
+        contact.point = orientedBox.toWorld(contact.point);
+        return true;
+    }
+
+private:
+    static SimdFloat simdAbs(SimdFloat value) {
+        return simdMax(value, SimdFloat(0.0f) - value);
+    }
+
+    // Separation of all pairs in a register along one of the 15 axes, in A's frame
+    static SimdFloat axisSeparation(int axis, const SimdFloat* halfA, const SimdFloat* halfB, const SimdFloat (*r)[3],
+        const SimdFloat (*absR)[3], const SimdFloat* t, SimdFloat degenerate) {
+        if (axis < 3) {
+            SimdFloat radiusB = halfB[0] * absR[axis][0] + halfB[1] * absR[axis][1] + halfB[2] * absR[axis][2];
+            return simdAbs(t[axis]) - halfA[axis] - radiusB;
+        }
+        if (axis < 6) {
+            int j = axis - 3;
+            SimdFloat radiusA = halfA[0] * absR[0][j] + halfA[1] * absR[1][j] + halfA[2] * absR[2][j];
+            SimdFloat distance = t[0] * r[0][j] + t[1] * r[1][j] + t[2] * r[2][j];
+            SimdFloat separation = simdAbs(distance) - radiusA - halfB[j];
+
+            // An axis of B parallel to one of A repeats that axis exactly. Skipping it keeps
+            // stacked boxes from having two equally good axes, which would void the cache.
+            SimdFloat alignment = simdMax(simdMax(absR[0][j], absR[1][j]), absR[2][j]);
+            return simdSelect(simdGreater(alignment, SimdFloat(1.0f - 1e-5f)), degenerate, separation);
+        }
+
+        int i = (axis - 6) / 3;
+        int j = (axis - 6) % 3;
+        int i1 = (i + 1) % 3, i2 = (i + 2) % 3;
+        int j1 = (j + 1) % 3, j2 = (j + 2) % 3;
+        SimdFloat radiusA = halfA[i1] * absR[i2][j] + halfA[i2] * absR[i1][j];
+        SimdFloat radiusB = halfB[j1] * absR[i][j2] + halfB[j2] * absR[i][j1];
+        SimdFloat distance = t[i2] * r[i1][j] - t[i1] * r[i2][j];
+
+        // |A[i] x B[j]| = sin of the angle between the edges, normalize to get a distance
+        SimdFloat lengthSquared = simdMax(SimdFloat(1.0f) - r[i][j] * r[i][j], SimdFloat(0.0f));
+        SimdFloat length = simdSqrt(lengthSquared);
+        SimdFloat separation = (simdAbs(distance) - radiusA - radiusB) / simdMax(length, SimdFloat(1e-3f));
+        return simdSelect(simdLess(length, SimdFloat(1e-3f)), degenerate, separation);
+    }
+
+    static OrientedBox batchBox(const BoxPairBatch& batch, size_t pair, bool first) {
+        OrientedBox box;
+        const std::vector<float>* axes = first ? batch.axisA : batch.axisB;
+        if (first) {
+            box.center = glm::vec3(batch.centerAX[pair], batch.centerAY[pair], batch.centerAZ[pair]);
+            box.halfExtents = glm::vec3(batch.halfAX[pair], batch.halfAY[pair], batch.halfAZ[pair]);
+        }
+        else {
+            box.center = glm::vec3(batch.centerBX[pair], batch.centerBY[pair], batch.centerBZ[pair]);
+            box.halfExtents = glm::vec3(batch.halfBX[pair], batch.halfBY[pair], batch.halfBZ[pair]);
+        }
+        for (int i = 0; i < 3; ++i) {
+            box.axes[i] = glm::vec3(axes[3 * i][pair], axes[3 * i + 1][pair], axes[3 * i + 2][pair]);
+        }
+        return box;
+    }
+
+    static void insideBoxContact(const glm::vec3& center, float radius, const glm::vec3& boxMin, const glm::vec3& boxMax, Contact& contact) {
+        float bestDistance = 1e30f;
+        for (int axis = 0; axis < 3; ++axis) {
+            float toMin = center[axis] - boxMin[axis];
+            float toMax = boxMax[axis] - center[axis];
+            if (toMin < bestDistance) {
+                bestDistance = toMin;
+                contact.normal = glm::vec3(0.0f);
+                contact.normal[axis] = -1.0f;
+            }
+            if (toMax < bestDistance) {
+                bestDistance = toMax;
+                contact.normal = glm::vec3(0.0f);
+                contact.normal[axis] = 1.0f;
+            }
+        }
+        contact.depth = bestDistance + radius;
+        contact.point = center + contact.normal * bestDistance;
+    }
+};
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef ORIENTED_BOX_H
+#define ORIENTED_BOX_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <AABB.h>
+
+#include <cmath>
+
+// Box in world space that can be turned any way, given by its center, the half size along
+// each of its own axes and those axes as unit vectors
+struct OrientedBox {
+    glm::vec3 center;
+    glm::vec3 halfExtents;
+    glm::vec3 axes[3];
+
+    OrientedBox() : center(0.0f), halfExtents(0.0f) {
+        axes[0] = glm::vec3(1.0f, 0.0f, 0.0f);
+        axes[1] = glm::vec3(0.0f, 1.0f, 0.0f);
+        axes[2] = glm::vec3(0.0f, 0.0f, 1.0f);
+    }
+
+    // Local box from min to max, turned by orientation around position
+    OrientedBox(const glm::vec3& position, const glm::quat& orientation, const glm::vec3& localMin, const glm::vec3& localMax) {
+        glm::mat3 basis = glm::mat3_cast(orientation);
+        axes[0] = basis[0];
+        axes[1] = basis[1];
+        axes[2] = basis[2];
+        halfExtents = (localMax - localMin) * 0.5f;
+        center = position + basis * ((localMin + localMax) * 0.5f);
+    }
+
+    // Axis aligned box as an oriented one
+    explicit OrientedBox(const AABB& box) : OrientedBox() {
+        center = (box.min + box.max) * 0.5f;
+        halfExtents = (box.max - box.min) * 0.5f;
+    }
+
+    AABB getAABB() const {
+        glm::vec3 extents = glm::abs(axes[0]) * halfExtents.x + glm::abs(axes[1]) * halfExtents.y + glm::abs(axes[2]) * halfExtents.z;
+        return AABB(center - extents, center + extents);
+    }
+
+    // World point in the box frame, relative to its center
+    glm::vec3 toLocal(const glm::vec3& point) const {
+        glm::vec3 offset = point - center;
+        return glm::vec3(glm::dot(offset, axes[0]), glm::dot(offset, axes[1]), glm::dot(offset, axes[2]));
+    }
+
+    glm::vec3 toWorldDirection(const glm::vec3& direction) const {
+        return axes[0] * direction.x + axes[1] * direction.y + axes[2] * direction.z;
+    }
+
+    glm::vec3 toWorld(const glm::vec3& point) const {
+        return center + toWorldDirection(point);
+    }
+
+    // Corner furthest along the direction
+    glm::vec3 support(const glm::vec3& direction) const {
+        glm::vec3 point = center;
+        for (int axis = 0; axis < 3; ++axis) {
+            point += axes[axis] * (glm::dot(axes[axis], direction) >= 0.0f ? halfExtents[axis] : -halfExtents[axis]);
+        }
+        return point;
+    }
+};
+
+#endif
@@ -0,0 +1,109 @@
+#ifndef PHYSICS_SIMD_H
+#define PHYSICS_SIMD_H
+
+// Thin wrapper over the widest float vector the compiler targets. Physics kernels are
+// written once against SimdFloat and run 8 lanes wide with AVX2, 4 with SSE and 1 otherwise.
+#if defined(__AVX2__)
+#define PHYSICS_SIMD_AVX2
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PHYSICS_SIMD_SSE
+#include <emmintrin.h>
+#endif
+
+#include <cmath>
+#include <algorithm>
+
+#if defined(PHYSICS_SIMD_AVX2)
+
+struct SimdFloat {
+    static const int width = 8;
+    __m256 v;
+
+    SimdFloat() : v(_mm256_setzero_ps()) {}
+    SimdFloat(__m256 value) : v(value) {}
+    explicit SimdFloat(float value) : v(_mm256_set1_ps(value)) {}
+
+    static SimdFloat load(const float* memory) { return _mm256_loadu_ps(memory); }
+    void store(float* memory) const { _mm256_storeu_ps(memory, v); }
+};
+
+inline SimdFloat operator+(SimdFloat a, SimdFloat b) { return _mm256_add_ps(a.v, b.v); }
+inline SimdFloat operator-(SimdFloat a, SimdFloat b) { return _mm256_sub_ps(a.v, b.v); }
+inline SimdFloat operator*(SimdFloat a, SimdFloat b) { return _mm256_mul_ps(a.v, b.v); }
+inline SimdFloat operator/(SimdFloat a, SimdFloat b) { return _mm256_div_ps(a.v, b.v); }
+inline SimdFloat operator&(SimdFloat a, SimdFloat b) { return _mm256_and_ps(a.v, b.v); }
+inline SimdFloat operator|(SimdFloat a, SimdFloat b) { return _mm256_or_ps(a.v, b.v); }
+inline SimdFloat simdMin(SimdFloat a, SimdFloat b) { return _mm256_min_ps(a.v, b.v); }
+inline SimdFloat simdMax(SimdFloat a, SimdFloat b) { return _mm256_max_ps(a.v, b.v); }
+inline SimdFloat simdSqrt(SimdFloat a) { return _mm256_sqrt_ps(a.v); }
+// Comparisons return all bits set in the lanes where they hold
+inline SimdFloat simdLess(SimdFloat a, SimdFloat b) { return _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ); }
+inline SimdFloat simdLessEqual(SimdFloat a, SimdFloat b) { return _mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ); }
+inline SimdFloat simdGreater(SimdFloat a, SimdFloat b) { return _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ); }
+inline SimdFloat simdSelect(SimdFloat mask, SimdFloat ifTrue, SimdFloat ifFalse) { return _mm256_blendv_ps(ifFalse.v, ifTrue.v, mask.v); }
+inline int simdMoveMask(SimdFloat mask) { return _mm256_movemask_ps(mask.v); }
+
+#elif defined(PHYSICS_SIMD_SSE)
+
+struct SimdFloat {
+    static const int width = 4;
+    __m128 v;
+
+    SimdFloat() : v(_mm_setzero_ps()) {}
+    SimdFloat(__m128 value) : v(value) {}
+    explicit SimdFloat(float value) : v(_mm_set1_ps(value)) {}
+
+    static SimdFloat load(const float* memory) { return _mm_loadu_ps(memory); }
+    void store(float* memory) const { _mm_storeu_ps(memory, v); }
+};
+
+inline SimdFloat operator+(SimdFloat a, SimdFloat b) { return _mm_add_ps(a.v, b.v); }
+inline SimdFloat operator-(SimdFloat a, SimdFloat b) { return _mm_sub_ps(a.v, b.v); }
+inline SimdFloat operator*(SimdFloat a, SimdFloat b) { return _mm_mul_ps(a.v, b.v); }
+inline SimdFloat operator/(SimdFloat a, SimdFloat b) { return _mm_div_ps(a.v, b.v); }
+inline SimdFloat operator&(SimdFloat a, SimdFloat b) { return _mm_and_ps(a.v, b.v); }
+inline SimdFloat operator|(SimdFloat a, SimdFloat b) { return _mm_or_ps(a.v, b.v); }
+inline SimdFloat simdMin(SimdFloat a, SimdFloat b) { return _mm_min_ps(a.v, b.v); }
+inline SimdFloat simdMax(SimdFloat a, SimdFloat b) { return _mm_max_ps(a.v, b.v); }
+inline SimdFloat simdSqrt(SimdFloat a) { return _mm_sqrt_ps(a.v); }
+inline SimdFloat simdLess(SimdFloat a, SimdFloat b) { return _mm_cmplt_ps(a.v, b.v); }
+inline SimdFloat simdLessEqual(SimdFloat a, SimdFloat b) { return _mm_cmple_ps(a.v, b.v); }
+inline SimdFloat simdGreater(SimdFloat a, SimdFloat b) { return _mm_cmpgt_ps(a.v, b.v); }
+inline SimdFloat simdSelect(SimdFloat mask, SimdFloat ifTrue, SimdFloat ifFalse) {
+    return _mm_or_ps(_mm_and_ps(mask.v, ifTrue.v), _mm_andnot_ps(mask.v, ifFalse.v));
+}
+inline int simdMoveMask(SimdFloat mask) { return _mm_movemask_ps(mask.v); }
+
+#else
+
+struct SimdFloat {
+    static const int width = 1;
+    float v;
+
+    SimdFloat() : v(0.0f) {}
+    explicit SimdFloat(float value) : v(value) {}
+
+    static SimdFloat load(const float* memory) { return SimdFloat(*memory); }
+    void store(float* memory) const { *memory = v; }
+};
+
+inline SimdFloat operator+(SimdFloat a, SimdFloat b) { return SimdFloat(a.v + b.v); }
+inline SimdFloat operator-(SimdFloat a, SimdFloat b) { return SimdFloat(a.v - b.v); }
+inline SimdFloat operator*(SimdFloat a, SimdFloat b) { return SimdFloat(a.v * b.v); }
+inline SimdFloat operator/(SimdFloat a, SimdFloat b) { return SimdFloat(a.v / b.v); }
+inline SimdFloat simdMin(SimdFloat a, SimdFloat b) { return SimdFloat(std::min(a.v, b.v)); }
+inline SimdFloat simdMax(SimdFloat a, SimdFloat b) { return SimdFloat(std::max(a.v, b.v)); }
+inline SimdFloat simdSqrt(SimdFloat a) { return SimdFloat(std::sqrt(a.v)); }
+// Masks are 1 or 0 in the scalar fallback
+inline SimdFloat operator&(SimdFloat a, SimdFloat b) { return SimdFloat((a.v != 0.0f && b.v != 0.0f) ? 1.0f : 0.0f); }
+inline SimdFloat operator|(SimdFloat a, SimdFloat b) { return SimdFloat((a.v != 0.0f || b.v != 0.0f) ? 1.0f : 0.0f); }
+inline SimdFloat simdLess(SimdFloat a, SimdFloat b) { return SimdFloat(a.v < b.v ? 1.0f : 0.0f); }
+inline SimdFloat simdLessEqual(SimdFloat a, SimdFloat b) { return SimdFloat(a.v <= b.v ? 1.0f : 0.0f); }
+inline SimdFloat simdGreater(SimdFloat a, SimdFloat b) { return SimdFloat(a.v > b.v ? 1.0f : 0.0f); }
+inline SimdFloat simdSelect(SimdFloat mask, SimdFloat ifTrue, SimdFloat ifFalse) { return mask.v != 0.0f ? ifTrue : ifFalse; }
+inline int simdMoveMask(SimdFloat mask) { return mask.v != 0.0f ? 1 : 0; }
+
+#endif
+
+#endif
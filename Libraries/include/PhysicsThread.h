@@ -0,0 +1,234 @@
+#ifndef PHYSICS_THREAD_H
+#define PHYSICS_THREAD_H
+
+#include <PhysicsWorld.h>
+#include <Transform.h>
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <chrono>
+#include <utility>
+#include <cstdint>
+#include <algorithm>
+
+// Body poses after one fixed step of a PhysicsThread
+struct PhysicsSnapshot {
+    typedef std::chrono::steady_clock Clock;
+
+    // Indexed by handle id like the slots of the world
+    std::vector<BodyPose> poses;
+    // Scheduled start of the step. Rendering blends from the previous to the current pose
+    // over one time step from here, so it stays one step behind the simulation.
+    Clock::time_point time;
+    float timeStep = 0.0f;
+    uint64_t stepCount = 0;
+
+    // Bodies added after the step or removed before it aren't in the snapshot
+    bool contains(BodyHandle body) const {
+        return body.id < poses.size() && poses[body.id].generation == body.generation;
+    }
+
+    // How far the render time is between the previous and the current pose, from 0 to 1
+    float getInterpolationAlpha(Clock::time_point now) const {
+        if (timeStep <= 0.0f) {
+            return 1.0f;
+        }
+        float alpha = std::chrono::duration<float>(now - time).count() / timeStep;
+        return std::min(std::max(alpha, 0.0f), 1.0f);
+    }
+
+    glm::vec3 getPosition(BodyHandle body) const {
+        return poses[body.id].position;
+    }
+
+    glm::vec3 getRotation(BodyHandle body) const {
+        return poses[body.id].rotation;
+    }
+
+    // Bodies that didn't move get their pose back exactly, mixing could be off by a bit
+    // depending on alpha and make cached transforms rebuild their matrix every frame
+    glm::vec3 getInterpolatedPosition(BodyHandle body, float alpha) const {
+        const BodyPose& pose = poses[body.id];
+        if (pose.previousPosition == pose.position) {
+            return pose.position;
+        }
+        return glm::mix(pose.previousPosition, pose.position, alpha);
+    }
+
+    glm::vec3 getInterpolatedRotation(BodyHandle body, float alpha) const {
+        const BodyPose& pose = poses[body.id];
+        if (pose.previousRotation == pose.rotation) {
+            return pose.rotation;
+        }
+        return glm::mix(pose.previousRotation, pose.rotation, alpha);
+    }
+};
+
+// Steps a PhysicsWorld on its own thread at the fixed time step of the world, so a frame
+// costs the longer of physics and rendering instead of both. Every step writes the poses
+// into one of three snapshots. The render thread takes the newest finished one without
+// locking and neither thread ever waits for the other to finish a frame.
+//
+// The world must not be used directly while the thread runs. Commands given to enqueue run
+// on the physics thread before the next step. synchronize runs a function between two
+// steps and returns its result, for calls like addBody that the caller has to wait for.
+class PhysicsThread {
+public:
+    typedef std::chrono::steady_clock Clock;
+    typedef std::function<void(PhysicsWorld&)> Command;
+
+    explicit PhysicsThread(PhysicsWorld& world)
+        : world(world), running(false), latest(1), back(0), front(2), stepCount(0) {
+    }
+
+    ~PhysicsThread() {
+        stop();
+    }
+
+    PhysicsThread(const PhysicsThread&) = delete;
+    PhysicsThread& operator=(const PhysicsThread&) = delete;
+
+    // Publishes the current state right away, so the first frame already has a snapshot
+    void start() {
+        if (running) {
+            return;
+        }
+        publish(Clock::now(), 0.0f);
+        running = true;
+        thread = std::thread(&PhysicsThread::run, this);
+    }
+
+    // Waits for the running step to finish. Commands still queued run on the next
+    // synchronize or once the thread is started again.
+    void stop() {
+        if (!running) {
+            return;
+        }
+        running = false;
+        thread.join();
+    }
+
+    bool isRunning() const {
+        return running;
+    }
+
+    void enqueue(Command command) {
+        std::lock_guard<std::mutex> lock(commandMutex);
+        commands.push_back(std::move(command));
+    }
+
+    // Runs the queued commands and then function on the world between two steps, blocking
+    // for at most one step
+    template <typename Function>
+    auto synchronize(Function function) -> decltype(function(std::declval<PhysicsWorld&>())) {
+        std::lock_guard<std::mutex> lock(stepMutex);
+        runCommands();
+        return function(world);
+    }
+
+    // Newest finished snapshot. Only the render thread may call this, the reference stays
+    // valid until its next call.
+    const PhysicsSnapshot& acquireSnapshot() {
+        if (latest.load(std::memory_order_relaxed) & freshBit) {
+            front = latest.exchange(front, std::memory_order_acq_rel) & indexMask;
+        }
+        return snapshots[front];
+    }
+
+    // Render transform of a body at the interpolated pose of a snapshot, kept per handle slot
+    // on the render side like PhysicsWorld::getInterpolatedTransform. Resting bodies keep
+    // their pose, so their matrix is built once and reused every frame. Only the render
+    // thread may call this.
+    Transform& getInterpolatedTransform(const PhysicsSnapshot& snapshot, BodyHandle body, float alpha) {
+        if (body.id >= renderTransforms.size()) {
+            renderTransforms.resize(body.id + 1);
+        }
+        Transform& transform = renderTransforms[body.id];
+        transform.setPosition(snapshot.getInterpolatedPosition(body, alpha));
+        transform.setRotation(snapshot.getInterpolatedRotation(body, alpha));
+        return transform;
+    }
+
+private:
+    // Low bits of latest are a snapshot index, freshBit is set while the render thread
+    // hasn't taken that snapshot yet
+    static constexpr uint32_t indexMask = 3u;
+    static constexpr uint32_t freshBit = 4u;
+
+    PhysicsWorld& world;
+    std::thread thread;
+    std::atomic<bool> running;
+
+    // Each of the three snapshots is owned by exactly one of back (physics thread), latest
+    // (shared) and front (render thread), publishing and acquiring swap ownership
+    PhysicsSnapshot snapshots[3];
+    std::atomic<uint32_t> latest;
+    uint32_t back;
+    uint32_t front;
+    uint64_t stepCount;
+
+    // Held while stepping, synchronize takes it to get between two steps
+    std::mutex stepMutex;
+    std::mutex commandMutex;
+    std::vector<Command> commands;
+    std::vector<Command> runningCommands;
+
+    // Render thread only, see getInterpolatedTransform
+    std::vector<Transform> renderTransforms;
+
+    void run() {
+        Clock::time_point nextStep = Clock::now();
+        while (running) {
+            Clock::time_point now = Clock::now();
+            if (now < nextStep) {
+                std::this_thread::sleep_until(nextStep);
+                continue;
+            }
+
+            float timeStep;
+            int maxSubSteps;
+            {
+                std::lock_guard<std::mutex> lock(stepMutex);
+                runCommands();
+                timeStep = world.getFixedTimeStep();
+                maxSubSteps = world.getMaxSubSteps();
+                world.fixedStep(timeStep);
+                publish(nextStep, timeStep);
+            }
+
+            Clock::duration stepDuration = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<float>(timeStep));
+            nextStep += stepDuration;
+            // Like PhysicsWorld::step, time beyond maxSubSteps steps is dropped instead of
+            // making every following step late as well
+            if (Clock::now() - nextStep > stepDuration * maxSubSteps) {
+                nextStep = Clock::now();
+            }
+        }
+    }
+
+    // Swaps the queue out first, so commands can be enqueued while earlier ones run
+    void runCommands() {
+        {
+            std::lock_guard<std::mutex> lock(commandMutex);
+            std::swap(commands, runningCommands);
+        }
+        for (size_t i = 0; i < runningCommands.size(); ++i) {
+            runningCommands[i](world);
+        }
+        runningCommands.clear();
+    }
+
+    void publish(Clock::time_point time, float timeStep) {
+        PhysicsSnapshot& snapshot = snapshots[back];
+        world.storePoses(snapshot.poses);
+        snapshot.time = time;
+        snapshot.timeStep = timeStep;
+        snapshot.stepCount = ++stepCount;
+        back = latest.exchange(back | freshBit, std::memory_order_acq_rel) & indexMask;
+    }
+};
+
+#endif
@@ -0,0 +1,1875 @@
+#ifndef PHYSICS_WORLD_H
+#define PHYSICS_WORLD_H
+
+#include <Rigidbody.h>
+#include <Collision.h>
+#include <CollisionDispatch.h>
+#include <BodyStorage.h>
+#include <Narrowphase.h>
+#include <PhysicsSimd.h>
+#include <SpatialHashGrid.h>
+#include <DynamicTree.h>
+#include <JobSystem.h>
+#include <ContactSolver.h>
+#include <SceneQuery.h>
+#include <MeshCollider.h>
+
+#include <vector>
+#include <cstdint>
+#include <utility>
+#include <algorithm>
+#include <memory>
+#include <cmath>
+#include <chrono>
+#include <cassert>
+
+enum class BroadphaseType {
+    SpatialHash,
+    DynamicTree
+};
+
+struct RaycastHit {
+    BodyHandle body;
+    float distance;
+    glm::vec3 point;
+    glm::vec3 normal;
+};
+
+// Pose of a body before and after the last fixed step, copied out for rendering on
+// another thread. The generation tells a live body apart from a removed one.
+struct BodyPose {
+    glm::vec3 previousPosition;
+    glm::vec3 position;
+    glm::vec3 previousRotation;
+    glm::vec3 rotation;
+    uint32_t generation;
+};
+
+// Time the last fixed step spent in each phase, in milliseconds
+struct PhysicsProfile {
+    float broadphase = 0.0f;
+    float narrowphase = 0.0f;
+    // Island building and the contact solver
+    float solve = 0.0f;
+    // Velocity and position integration, including the continuous collision sweeps
+    float integrate = 0.0f;
+    float sleep = 0.0f;
+    float total = 0.0f;
+};
+
+// Last separating axis test result of a box pair, keyed by the handles of both boxes
+struct BoxPairCache {
+    uint64_t key;
+    // Center of B minus center of A and the rotations of both when the axis was found
+    glm::vec3 offset;
+    glm::vec3 rotationA;
+    glm::vec3 rotationB;
+    float separation;
+    float gap;
+    uint8_t axis;
+    bool separated;
+
+    bool operator<(const BoxPairCache& other) const { return key < other.key; }
+};
+
+// Pair of handle ids found by the dynamic tree, kept while the fat boxes of both bodies
+// overlap. Sphere pairs and sphere vs axis aligned box pairs also keep how far apart their
+// surfaces were at the last test. The surfaces can't have come closer than the offset
+// between the bodies changed since, so the pair skips the narrowphase until that change
+// could have closed the distance. Comparing offsets instead of adding up velocities keeps
+// teleported bodies safe.
+struct TreePair {
+    uint32_t first;
+    uint32_t second;
+    // Position of second minus position of first at the last test
+    glm::vec3 offset;
+    // Negative until a test found the surfaces apart
+    float separation;
+
+    TreePair(uint32_t a, uint32_t b)
+        : first(std::min(a, b)), second(std::max(a, b)), offset(0.0f), separation(-1.0f) {
+    }
+
+    bool operator<(const TreePair& other) const {
+        return first < other.first || (first == other.first && second < other.second);
+    }
+
+    bool operator==(const TreePair& other) const {
+        return first == other.first && second == other.second;
+    }
+};
+
+// Owns a set of rigidbodies and steps them together. Body state is stored as structure of
+// arrays and integrated with SIMD, collision pairs come from a broadphase instead of
+// testing every body against every other body. Contacts are grouped into islands of
+// touching bodies which the sequential impulse solver handles in parallel.
+//
+// The body arrays are kept partitioned as [awake | sleeping and static]. Only the awake
+// range is integrated and moved in the broadphase, so bodies that came to rest cost
+// almost nothing until something touches them.
+class PhysicsWorld {
+public:
+    static constexpr uint32_t invalidIndex = 0xFFFFFFFFu;
+    static constexpr uint32_t layerCount = 32;
+    // Level k of the physics level of detail steps every 2^k fixed steps
+    static constexpr uint32_t lodLevelCount = 4;
+    static constexpr uint8_t frozenLod = 0xFF;
+
+    PhysicsWorld(BroadphaseType type = BroadphaseType::DynamicTree, float cellSize = 2.0f)
+        : broadphaseType(type), linearDamping(0.98f), angularDamping(0.8f), forcesPending(false), awakeCount(0),
+        sleepingEnabled(true), linearSleepVelocity(0.15f), angularSleepVelocity(2.0f), timeToSleep(0.5f),
+        fixedTimeStep(1.0f / 60.0f), maxSubSteps(4), accumulator(0.0f), lodStep(0), grid(cellSize), jobSystem(new JobSystem()) {
+        std::fill(layerMatrix, layerMatrix + layerCount, 0xFFFFFFFFu);
+        setLodDistances(50.0f, 100.0f, 200.0f, 400.0f);
+    }
+
+    // Number of extra threads solving islands, 0 solves everything on the calling thread.
+    // The result of a step doesn't depend on it.
+    void setWorkerCount(unsigned workerCount) {
+        jobSystem.reset(new JobSystem(workerCount));
+    }
+
+    unsigned getWorkerCount() const {
+        return jobSystem->getWorkerCount();
+    }
+
+    // Copies the rigidbody into the world, later changes go through the returned handle
+    BodyHandle addBody(const Rigidbody& body) {
+        BodyHandle handle = makeHandle(allocateSlot());
+
+        uint32_t index = (uint32_t)bodies.size();
+        handleToIndex[handle.id] = index;
+        bodies.push(body, handle.id);
+        bodies.filterMask[index] = applyLayerMatrix(bodies.collisionLayer[index], bodies.collisionMask[index]);
+        forcesPending |= body.getForce() != glm::vec3(0.0f);
+        proxies[handle.id] = tree.createProxy(bodies.getAABB(index), handle.id);
+        transforms[handle.id] = body.getTransform();
+        bodyMeshes[handle.id] = invalidIndex;
+        movedBodies.push_back(handle.id);
+
+        // New dynamic bodies start awake
+        if (!bodies.isStatic(index)) {
+            swapBodies(index, awakeCount++);
+        }
+        return handle;
+    }
+
+    // Adds count bodies at once and writes their handles. Every array grows once up front,
+    // so spawning thousands of bodies doesn't reallocate on the way.
+    void addBodies(const Rigidbody* source, size_t count, BodyHandle* handles) {
+        reserveForSpawn(count);
+        for (size_t i = 0; i < count; ++i) {
+            handles[i] = addBody(source[i]);
+        }
+    }
+
+    // Spawns count copies of the prototype, one at each position
+    void addBodies(const Rigidbody& prototype, const glm::vec3* positions, size_t count, BodyHandle* handles) {
+        reserveForSpawn(count);
+        Rigidbody body = prototype;
+        for (size_t i = 0; i < count; ++i) {
+            body.setPosition(positions[i]);
+            handles[i] = addBody(body);
+        }
+    }
+
+    // Adds a static triangle mesh. Its hierarchy is built once by the MeshCollider and the
+    // world only keeps its overall bounds in the broadphase.
+    BodyHandle addMeshCollider(MeshCollider mesh) {
+        AABB meshBounds = mesh.getBounds();
+        Rigidbody body(glm::vec3(0.0f), 0.0f, glm::vec3(0.0f), meshBounds.min, meshBounds.max);
+        body.setStatic(true);
+        body.colliderType = Rigidbody::ColliderType::Mesh;
+
+        BodyHandle handle = addBody(body);
+        bodyMeshes[handle.id] = (uint32_t)meshColliders.size();
+        meshColliders.push_back(std::unique_ptr<MeshCollider>(new MeshCollider(std::move(mesh))));
+        return handle;
+    }
+
+    void removeBody(BodyHandle body) {
+        if (!checkHandle(body)) {
+            return;
+        }
+        // Bodies resting on this one have to start falling again
+        AABB bounds = bodies.getAABB(handleToIndex[body.id]);
+        queryOverlap(AABB(bounds.min - glm::vec3(0.1f), bounds.max + glm::vec3(0.1f)), touchingBodies);
+        for (size_t i = 0; i < touchingBodies.size(); ++i) {
+            wakeBody(touchingBodies[i]);
+        }
+
+        uint32_t index = handleToIndex[body.id];
+        uint32_t last = (uint32_t)bodies.size() - 1;
+
+        // Keep the arrays dense and partitioned, first close the hole in the awake range
+        if (index < awakeCount) {
+            swapBodies(index, --awakeCount);
+            index = awakeCount;
+        }
+        swapBodies(index, last);
+        bodies.pop();
+        handleToIndex[body.id] = invalidIndex;
+
+        // Pairs referencing the body are dropped on the next step
+        tree.destroyProxy(proxies[body.id]);
+        proxies[body.id] = DynamicTree::nullNode;
+
+        if (bodyMeshes[body.id] != invalidIndex) {
+            meshColliders[bodyMeshes[body.id]].reset();
+            bodyMeshes[body.id] = invalidIndex;
+        }
+
+        // Old handles to the slot stop being valid right away, the slot itself is reused
+        // after the next step
+        ++slotGenerations[body.id];
+        retiredSlots.push_back(body.id);
+    }
+
+    void removeBodies(const BodyHandle* handles, size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            removeBody(handles[i]);
+        }
+    }
+
+    bool isValid(BodyHandle body) const {
+        return body.id < handleToIndex.size() && slotGenerations[body.id] == body.generation && handleToIndex[body.id] != invalidIndex;
+    }
+
+    // Accessors expect a valid handle, a stale one asserts in debug builds. Release builds
+    // ignore setters and removeBody called with a stale handle instead of touching whatever
+    // body reused the slot.
+
+    size_t getBodyCount() const {
+        return bodies.size();
+    }
+
+    size_t getAwakeBodyCount() const {
+        return awakeCount;
+    }
+
+    void reserve(size_t count) {
+        bodies.reserve(count);
+        handleToIndex.reserve(count);
+        slotGenerations.reserve(count);
+        transforms.reserve(count);
+        proxies.reserve(count);
+        bodyMeshes.reserve(count);
+        movedBodies.reserve(count);
+        tree.reserve(count);
+    }
+
+    // Setters wake the body up. Position and rotation changes teleport, they aren't
+    // interpolated, and moving a static body refits its broadphase proxy right away.
+    glm::vec3 getPosition(BodyHandle body) const { return bodies.getPosition(indexOf(body)); }
+    glm::vec3 getVelocity(BodyHandle body) const { return bodies.getVelocity(indexOf(body)); }
+    void setVelocity(BodyHandle body, const glm::vec3& velocity) {
+        if (checkHandle(body)) {
+            bodies.setVelocity(touchBody(body), velocity);
+        }
+    }
+    glm::vec3 getRotation(BodyHandle body) const { return bodies.getRotation(indexOf(body)); }
+    glm::vec3 getAngularVelocity(BodyHandle body) const { return bodies.getAngularVelocity(indexOf(body)); }
+    void setAngularVelocity(BodyHandle body, const glm::vec3& angularVelocity) {
+        if (checkHandle(body)) {
+            bodies.setAngularVelocity(touchBody(body), angularVelocity);
+        }
+    }
+
+    void setPosition(BodyHandle body, const glm::vec3& position) {
+        if (!checkHandle(body)) {
+            return;
+        }
+        uint32_t index = touchBody(body);
+        bodies.setPosition(index, position);
+        bodies.storePreviousState(index, index + 1);
+        refitStatic(body);
+    }
+
+    void setRotation(BodyHandle body, const glm::vec3& rotation) {
+        if (!checkHandle(body)) {
+            return;
+        }
+        uint32_t index = touchBody(body);
+        bodies.setRotation(index, rotation);
+        bodies.storePreviousState(index, index + 1);
+    }
+
+    float getMass(BodyHandle body) const { return bodies.mass[indexOf(body)]; }
+    float getRadius(BodyHandle body) const { return bodies.radius[indexOf(body)]; }
+    AABB getAABB(BodyHandle body) const { return bodies.getAABB(indexOf(body)); }
+    bool isStatic(BodyHandle body) const { return bodies.isStatic(indexOf(body)); }
+    bool isContinuous(BodyHandle body) const { return bodies.continuous[indexOf(body)] != 0; }
+
+    // Continuous bodies get speculative contacts and a swept test against boxes, so they
+    // can't tunnel through thin geometry even at low step rates
+    void setContinuous(BodyHandle body, bool continuous) {
+        if (!checkHandle(body)) {
+            return;
+        }
+        bodies.continuous[handleToIndex[body.id]] = continuous ? 1 : 0;
+    }
+
+    uint32_t getCollisionLayer(BodyHandle body) const { return bodies.collisionLayer[indexOf(body)]; }
+    uint32_t getCollisionMask(BodyHandle body) const { return bodies.collisionMask[indexOf(body)]; }
+
+    // Same rules as Rigidbody::setCollisionFilter. Pairs the new filter rules out are dropped
+    // right away, new ones are found on the next step.
+    void setCollisionFilter(BodyHandle body, uint32_t layer, uint32_t mask) {
+        if (!checkHandle(body)) {
+            return;
+        }
+        uint32_t index = touchBody(body);
+        bodies.collisionLayer[index] = layer;
+        bodies.collisionMask[index] = mask;
+        bodies.filterMask[index] = applyLayerMatrix(layer, mask);
+        dropFilteredPairs();
+        movedBodies.push_back(body.id);
+    }
+
+    // Turns collisions between two layers on or off for every body, layers are bit indices
+    // from 0 to 31. All layer pairs collide by default.
+    void setLayersCollide(uint32_t layerA, uint32_t layerB, bool collide) {
+        if (!checkLayers(layerA, layerB)) {
+            return;
+        }
+        if (collide) {
+            layerMatrix[layerA] |= 1u << layerB;
+            layerMatrix[layerB] |= 1u << layerA;
+        }
+        else {
+            layerMatrix[layerA] &= ~(1u << layerB);
+            layerMatrix[layerB] &= ~(1u << layerA);
+        }
+
+        for (size_t i = 0; i < bodies.size(); ++i) {
+            bodies.filterMask[i] = applyLayerMatrix(bodies.collisionLayer[i], bodies.collisionMask[i]);
+        }
+        dropFilteredPairs();
+        // Pairs that are allowed now have to be looked for again
+        if (collide) {
+            for (size_t i = 0; i < bodies.size(); ++i) {
+                movedBodies.push_back(bodies.handles[i]);
+            }
+        }
+    }
+
+    bool getLayersCollide(uint32_t layerA, uint32_t layerB) const {
+        if (!checkLayers(layerA, layerB)) {
+            return false;
+        }
+        return (layerMatrix[layerA] & (1u << layerB)) != 0;
+    }
+
+    Rigidbody::ColliderType getColliderType(BodyHandle body) const {
+        return (Rigidbody::ColliderType)bodies.colliderType[indexOf(body)];
+    }
+
+    void applyForce(BodyHandle body, const glm::vec3& force) {
+        if (!checkHandle(body)) {
+            return;
+        }
+        uint32_t index = touchBody(body);
+        bodies.setForce(index, bodies.getForce(index) + force);
+        forcesPending = true;
+    }
+
+    bool isAwake(BodyHandle body) const {
+        return indexOf(body) < awakeCount;
+    }
+
+    void wakeBody(BodyHandle body) {
+        if (!checkHandle(body)) {
+            return;
+        }
+        uint32_t index = handleToIndex[body.id];
+        if (index >= awakeCount && !bodies.isStatic(index)) {
+            wake(index);
+        }
+    }
+
+    // Turning sleeping off wakes every body
+    void setSleepingEnabled(bool enabled) {
+        sleepingEnabled = enabled;
+        if (!enabled) {
+            for (uint32_t i = awakeCount; i < bodies.size(); ++i) {
+                if (!bodies.isStatic(i)) {
+                    wake(i);
+                }
+            }
+        }
+    }
+
+    // A body falls asleep once it and every body touching it stayed below both speeds for
+    // timeToSleep seconds. Angular speed is in degrees per step like Rigidbody::rotation.
+    void setSleepThresholds(float linearVelocity, float angularVelocity, float time) {
+        linearSleepVelocity = linearVelocity;
+        angularSleepVelocity = angularVelocity;
+        timeToSleep = time;
+    }
+
+    // Velocity multipliers applied every step, same defaults as Rigidbody::update
+    void setDamping(float linear, float angular) {
+        linearDamping = linear;
+        angularDamping = angular;
+    }
+
+    // Physics level of detail. Dynamic bodies are bucketed by their distance to the closest
+    // focus point, usually the camera. Bodies past the first distance step every second
+    // fixed step with twice the time step, past the second every fourth and past the third
+    // every eighth. Bodies past the freeze distance stop entirely until a focus point comes
+    // close again, touching them doesn't wake them. Pairs are only tested on steps where
+    // both bodies step, so contacts between buckets are found a little late.
+    // No focus points turns the level of detail off, which is the default.
+    void setLodFocusPoints(const glm::vec3* points, size_t count) {
+        lodFocusPoints.assign(points, points + count);
+        if (count == 0) {
+            resetLod();
+        }
+    }
+
+    void setLodDistances(float halfRate, float quarterRate, float eighthRate, float freeze) {
+        lodDistances[0] = 0.0f;
+        lodDistances[1] = halfRate;
+        lodDistances[2] = quarterRate;
+        lodDistances[3] = eighthRate;
+        lodFreezeDistance = freeze;
+    }
+
+    // Level of detail bucket of the body, frozenLod for frozen bodies
+    uint8_t getLodLevel(BodyHandle body) const {
+        return bodies.lodLevel[indexOf(body)];
+    }
+
+    BroadphaseType getBroadphaseType() const {
+        return broadphaseType;
+    }
+
+    void setBroadphaseType(BroadphaseType type) {
+        if (type == broadphaseType) {
+            return;
+        }
+        broadphaseType = type;
+
+        // The tree isn't maintained while the grid is in use, refit everything
+        if (type == BroadphaseType::DynamicTree) {
+            treePairs.clear();
+            movedBodies.clear();
+            for (size_t i = 0; i < bodies.size(); ++i) {
+                tree.moveProxy(proxies[bodies.handles[i]], bodies.getAABB(i), glm::vec3(0.0f));
+                movedBodies.push_back(bodies.handles[i]);
+            }
+        }
+    }
+
+    SpatialHashGrid& getSpatialHashGrid() {
+        return grid;
+    }
+
+    DynamicTree& getDynamicTree() {
+        return tree;
+    }
+
+    // Candidate pairs found by the broadphase during the last step, as dense body indices
+    const std::vector<std::pair<uint32_t, uint32_t>>& getCandidatePairs() const {
+        return candidatePairs;
+    }
+
+    // Velocity iterations per step. Impulses carry over between steps, so resting stacks
+    // stay stable with few iterations.
+    void setSolverIterations(int iterations) {
+        solver.setIterations(iterations);
+    }
+
+    int getSolverIterations() const {
+        return solver.getIterations();
+    }
+
+    // Rate the simulation runs at, independent of the frame rate
+    void setFixedTimeStep(float timeStep) {
+        fixedTimeStep = timeStep;
+    }
+
+    float getFixedTimeStep() const {
+        return fixedTimeStep;
+    }
+
+    // Most fixed steps a single call to step may run. Time beyond that is dropped, so a slow
+    // frame can't make the next frame even slower.
+    void setMaxSubSteps(int subSteps) {
+        maxSubSteps = subSteps;
+    }
+
+    int getMaxSubSteps() const {
+        return maxSubSteps;
+    }
+
+    // Advances the world by the frame time in fixed steps, the remainder carries over to the
+    // next frame. Returns the number of fixed steps taken.
+    int step(float frameTime) {
+        accumulator += frameTime;
+
+        int subSteps = 0;
+        while (accumulator >= fixedTimeStep && subSteps < maxSubSteps) {
+            fixedStep(fixedTimeStep);
+            accumulator -= fixedTimeStep;
+            ++subSteps;
+        }
+
+        if (accumulator >= fixedTimeStep) {
+            accumulator = std::fmod(accumulator, fixedTimeStep);
+        }
+        return subSteps;
+    }
+
+    // How far rendering is between the last two fixed steps, from 0 to 1
+    float getInterpolationAlpha() const {
+        return accumulator / fixedTimeStep;
+    }
+
+    // Transform blended between the last two fixed steps, for rendering
+    glm::vec3 getInterpolatedPosition(BodyHandle body) const {
+        uint32_t index = indexOf(body);
+        return glm::mix(bodies.getPreviousPosition(index), bodies.getPosition(index), getInterpolationAlpha());
+    }
+
+    glm::vec3 getInterpolatedRotation(BodyHandle body) const {
+        uint32_t index = indexOf(body);
+        return glm::mix(bodies.getPreviousRotation(index), bodies.getRotation(index), getInterpolationAlpha());
+    }
+
+    // Render transform at the interpolated pose. Resting bodies keep the same pose, so their
+    // matrix is built once and reused every frame.
+    Transform& getInterpolatedTransform(BodyHandle body) {
+        Transform& transform = transforms[body.id];
+        transform.setPosition(getInterpolatedPosition(body));
+        transform.setRotation(getInterpolatedRotation(body));
+        return transform;
+    }
+
+    // Writes the pose of every body, indexed by handle id. Free slots get invalidIndex as
+    // generation, so no handle matches them.
+    void storePoses(std::vector<BodyPose>& poses) const {
+        poses.resize(handleToIndex.size());
+        for (size_t slot = 0; slot < handleToIndex.size(); ++slot) {
+            poses[slot].generation = invalidIndex;
+        }
+        for (size_t i = 0; i < bodies.size(); ++i) {
+            uint32_t slot = bodies.handles[i];
+            BodyPose& pose = poses[slot];
+            pose.generation = slotGenerations[slot];
+            pose.previousPosition = bodies.getPreviousPosition(i);
+            pose.position = bodies.getPosition(i);
+            pose.previousRotation = bodies.getPreviousRotation(i);
+            pose.rotation = bodies.getRotation(i);
+        }
+    }
+
+    // Runs one simulation step of exactly deltaTime seconds
+    void fixedStep(float deltaTime) {
+        Clock::time_point start = Clock::now();
+
+        bool lod = !lodFocusPoints.empty();
+        if (lod) {
+            prepareLodStep(deltaTime);
+        }
+
+        // Sleeping and static bodies don't move, their previous state is already current
+        bodies.storePreviousState(0, awakeCount);
+        if (lod) {
+            integrateVelocitiesLod(awakeCount);
+        }
+        else {
+            integrateVelocities(0, awakeCount, deltaTime);
+        }
+        Clock::time_point integrated = Clock::now();
+
+        if (broadphaseType == BroadphaseType::DynamicTree) {
+            updateTreePairs(deltaTime);
+        }
+        else {
+            updateGridPairs(deltaTime);
+        }
+        Clock::time_point broadphaseDone = Clock::now();
+
+        findContacts(deltaTime);
+        Clock::time_point narrowphaseDone = Clock::now();
+
+        buildIslands();
+        solveIslands(deltaTime);
+        Clock::time_point solved = Clock::now();
+
+        if (lod) {
+            integratePositionsLod(awakeCount);
+        }
+        else {
+            integratePositions(0, awakeCount, deltaTime);
+        }
+        sweepContinuousBodies();
+        Clock::time_point moved = Clock::now();
+
+        updateSleep(deltaTime);
+        Clock::time_point end = Clock::now();
+
+        // Nothing refers to the bodies removed before this step anymore
+        freeSlots.insert(freeSlots.end(), retiredSlots.begin(), retiredSlots.end());
+        retiredSlots.clear();
+
+        profile.broadphase = milliseconds(integrated, broadphaseDone);
+        profile.narrowphase = milliseconds(broadphaseDone, narrowphaseDone);
+        profile.solve = milliseconds(narrowphaseDone, solved);
+        profile.integrate = milliseconds(start, integrated) + milliseconds(solved, moved);
+        profile.sleep = milliseconds(moved, end);
+        profile.total = milliseconds(start, end);
+    }
+
+    // Phase timings of the last fixed step
+    const PhysicsProfile& getProfile() const {
+        return profile;
+    }
+
+    // Contacts generated during the last step
+    const std::vector<Contact>& getContacts() const {
+        return contacts;
+    }
+
+    // Number of contact islands solved during the last step
+    size_t getIslandCount() const {
+        return islandContactStart.empty() ? 0 : islandContactStart.size() - 1;
+    }
+
+    // Collects every body whose collider bounds overlap the box
+    void queryOverlap(const AABB& box, std::vector<BodyHandle>& results) {
+        results.clear();
+        if (broadphaseType != BroadphaseType::DynamicTree) {
+            for (size_t i = 0; i < bodies.size(); ++i) {
+                if (bodies.getAABB(i).overlaps(box)) {
+                    results.push_back(makeHandle(bodies.handles[i]));
+                }
+            }
+            return;
+        }
+
+        tree.query(box, [&](int32_t proxy) {
+            uint32_t handle = tree.getUserData(proxy);
+            if (bodies.getAABB(handleToIndex[handle]).overlaps(box)) {
+                results.push_back(makeHandle(handle));
+            }
+            return true;
+        });
+    }
+
+    // Finds the closest body hit by the ray, direction must be normalized
+    bool raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, RaycastHit& hit) {
+        bool found = false;
+        hit.distance = maxDistance;
+
+        if (broadphaseType != BroadphaseType::DynamicTree) {
+            for (size_t i = 0; i < bodies.size(); ++i) {
+                found |= raycastBody((uint32_t)i, origin, direction, hit);
+            }
+            return found;
+        }
+
+        tree.raycast(origin, direction, maxDistance, [&](int32_t proxy, float) {
+            found |= raycastBody(handleToIndex[tree.getUserData(proxy)], origin, direction, hit);
+            // Clip the ray to the closest hit so far
+            return hit.distance;
+        });
+        return found;
+    }
+
+    // Casts every ray and writes the closest hit of ray i to hits[i]. Rays that hit nothing
+    // get an invalid body handle. Returns the number of rays that hit something.
+    size_t raycastBatch(const RayQuery* rays, size_t count, RaycastHit* hits) {
+        size_t hitCount = 0;
+        for (size_t i = 0; i < count; ++i) {
+            hitCount += castQuery(rays[i].origin, rays[i].direction, 0.0f, rays[i].maxDistance, hits[i]);
+        }
+        return hitCount;
+    }
+
+    // Like raycastBatch for swept spheres, the hit point is where the sphere first touches.
+    // Boxes are grown by the radius, which is slightly conservative around their edges.
+    // Meshes are only hit by rays.
+    size_t sphereCastBatch(const SphereCastQuery* casts, size_t count, RaycastHit* hits) {
+        size_t hitCount = 0;
+        for (size_t i = 0; i < count; ++i) {
+            hitCount += castQuery(casts[i].origin, casts[i].direction, casts[i].radius, casts[i].maxDistance, hits[i]);
+        }
+        return hitCount;
+    }
+
+    // Writes the bodies touching each sphere volume into results back to back, resultCounts[i]
+    // is the number written for query i. Writing stops once capacity is reached, returns the
+    // total number of handles written.
+    size_t overlapBatch(const OverlapQuery* queries, size_t count, BodyHandle* results, size_t capacity, uint32_t* resultCounts) {
+        size_t written = 0;
+        for (size_t i = 0; i < count; ++i) {
+            const OverlapQuery& query = queries[i];
+            AABB bounds(query.center - glm::vec3(query.radius), query.center + glm::vec3(query.radius));
+
+            queryCandidates.clear();
+            queryBodies.clear();
+            if (broadphaseType == BroadphaseType::DynamicTree) {
+                tree.query(bounds, [&](int32_t proxy) {
+                    addQueryCandidate(handleToIndex[tree.getUserData(proxy)]);
+                    return true;
+                });
+            }
+            else {
+                for (size_t body = 0; body < bodies.size(); ++body) {
+                    addQueryCandidate((uint32_t)body);
+                }
+            }
+
+            overlapBodies.clear();
+            SceneQuery::overlapSphere(queryCandidates, query.center, query.radius, overlapBodies);
+            for (size_t j = 0; j < queryBodies.size(); ++j) {
+                if (overlapsBody(queryBodies[j], query.center, query.radius)) {
+                    overlapBodies.push_back(queryBodies[j]);
+                }
+            }
+
+            size_t queryCount = std::min(overlapBodies.size(), capacity - written);
+            for (size_t j = 0; j < queryCount; ++j) {
+                results[written + j] = makeHandle(bodies.handles[overlapBodies[j]]);
+            }
+            written += queryCount;
+            resultCounts[i] = (uint32_t)queryCount;
+        }
+        return written;
+    }
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    BodyStorage bodies;
+    // Dense index of the body in every handle slot, invalidIndex for free slots
+    std::vector<uint32_t> handleToIndex;
+    std::vector<uint32_t> slotGenerations;
+    std::vector<uint32_t> freeSlots;
+    // Slots freed since the last step. Pairs, manifolds and cache entries may still name
+    // them until a step has dropped them, so they only join freeSlots afterwards.
+    std::vector<uint32_t> retiredSlots;
+    // Render transform of every body, indexed by handle id
+    std::vector<Transform> transforms;
+    // Index into meshColliders for mesh bodies, indexed by handle id
+    std::vector<uint32_t> bodyMeshes;
+    std::vector<std::unique_ptr<MeshCollider>> meshColliders;
+    std::vector<MeshContact> meshContacts;
+    BroadphaseType broadphaseType;
+
+    // Layers each layer may collide with, one bit per layer, kept symmetric
+    uint32_t layerMatrix[layerCount];
+
+    float linearDamping;
+    float angularDamping;
+    bool forcesPending;
+
+    // Bodies [0, awakeCount) are awake, the rest are asleep or static
+    uint32_t awakeCount;
+    bool sleepingEnabled;
+    float linearSleepVelocity;
+    float angularSleepVelocity;
+    float timeToSleep;
+
+    float fixedTimeStep;
+    int maxSubSteps;
+    // Frame time not simulated yet
+    float accumulator;
+
+    std::vector<glm::vec3> lodFocusPoints;
+    // Distance where each level starts and where bodies freeze
+    float lodDistances[lodLevelCount];
+    float lodFreezeDistance;
+    // Fixed steps taken with the level of detail on, picks the levels that step
+    uint32_t lodStep;
+    // Time step, damping and rotation scale of every awake body for this step. Bodies that
+    // skip the step have a time step of 0.
+    std::vector<float> lodStepTime;
+    std::vector<float> lodLinearDamping;
+    std::vector<float> lodAngularDamping;
+    std::vector<float> lodRotationScale;
+    std::vector<uint32_t> lodFrozenBodies;
+    std::vector<uint32_t> lodThawedBodies;
+    std::vector<float> islandSleepTimer;
+    std::vector<uint32_t> sleepingBodies;
+    std::vector<uint32_t> wokenBodies;
+    std::vector<BodyHandle> touchingBodies;
+
+    std::vector<std::pair<uint32_t, uint32_t>> candidatePairs;
+    // Candidate pairs sorted by shape pair, then packed into the batches of their routine
+    ShapePairBuckets pairBuckets;
+    SpherePairBatch spherePairs;
+    SphereBoxPairBatch sphereBoxPairs;
+    BoxPairBatch boxPairs;
+    std::vector<BoxPairResult> boxPairResults;
+    // Outcome of the last full separating axis test of every box pair, sorted by key
+    std::vector<BoxPairCache> boxPairCache;
+    std::vector<BoxPairCache> nextBoxPairCache;
+    // Surface distances measured by the last batched sphere test
+    std::vector<float> pairSeparations;
+    std::vector<Contact> contacts;
+
+    SpatialHashGrid grid;
+
+    DynamicTree tree;
+    // Tree proxy of every body, indexed by handle id
+    std::vector<int32_t> proxies;
+    std::vector<uint32_t> movedBodies;
+    // Kept while their fat boxes overlap so resting bodies never requery the tree, candidate
+    // pair i is tree pair i while the tree is in use
+    std::vector<TreePair> treePairs;
+
+    ContactSolver solver;
+    std::unique_ptr<JobSystem> jobSystem;
+    // Union find parent of every dense body index, rebuilt each step
+    std::vector<uint32_t> islandParent;
+    // Island id of each union find root
+    std::vector<uint32_t> rootIsland;
+    // Contact indices grouped by island, island i owns [islandContactStart[i], islandContactStart[i + 1])
+    std::vector<uint32_t> islandContacts;
+    std::vector<uint32_t> islandContactStart;
+    std::vector<uint32_t> contactIsland;
+
+    PhysicsProfile profile;
+
+    // Scratch buffers of the batched scene queries
+    QueryCandidateBatch queryCandidates;
+    std::vector<uint32_t> queryBodies;
+    std::vector<uint32_t> overlapBodies;
+
+    static float milliseconds(Clock::time_point begin, Clock::time_point end) {
+        return std::chrono::duration<float, std::milli>(end - begin).count();
+    }
+
+    // Takes a free handle slot or appends one, the per slot arrays are filled by addBody
+    uint32_t allocateSlot() {
+        if (!freeSlots.empty()) {
+            uint32_t slot = freeSlots.back();
+            freeSlots.pop_back();
+            return slot;
+        }
+
+        uint32_t slot = (uint32_t)handleToIndex.size();
+        handleToIndex.push_back(invalidIndex);
+        slotGenerations.push_back(0);
+        proxies.push_back(DynamicTree::nullNode);
+        transforms.emplace_back();
+        bodyMeshes.push_back(invalidIndex);
+        return slot;
+    }
+
+    BodyHandle makeHandle(uint32_t slot) const {
+        BodyHandle handle;
+        handle.id = slot;
+        handle.generation = slotGenerations[slot];
+        return handle;
+    }
+
+    // Grows by at least half the current size, so repeated small batches still reallocate
+    // only a logarithmic number of times
+    void reserveForSpawn(size_t count) {
+        size_t needed = bodies.size() + count;
+        if (needed > bodies.handles.capacity()) {
+            reserve(std::max(needed, bodies.handles.capacity() + bodies.handles.capacity() / 2));
+        }
+    }
+
+    // Masks out the layers the matrix doesn't let any of the body's layers collide with
+    uint32_t applyLayerMatrix(uint32_t layer, uint32_t mask) const {
+        uint32_t allowed = 0;
+        for (uint32_t bit = 0; bit < layerCount; ++bit) {
+            if (layer & (1u << bit)) {
+                allowed |= layerMatrix[bit];
+            }
+        }
+        return mask & allowed;
+    }
+
+    // Tree pairs outlive the step they were found in, so filter changes prune them
+    void dropFilteredPairs() {
+        treePairs.erase(std::remove_if(treePairs.begin(), treePairs.end(), [&](const TreePair& pair) {
+            uint32_t first = handleToIndex[pair.first];
+            uint32_t second = handleToIndex[pair.second];
+            return first != invalidIndex && second != invalidIndex && !bodies.canCollide(first, second);
+        }), treePairs.end());
+    }
+
+    void swapBodies(uint32_t a, uint32_t b) {
+        if (a == b) {
+            return;
+        }
+        bodies.swap(a, b);
+        handleToIndex[bodies.handles[a]] = a;
+        handleToIndex[bodies.handles[b]] = b;
+    }
+
+    // Moves a sleeping body to the end of the awake range. Frozen bodies come back on the
+    // coarsest level until the next level of detail update.
+    uint32_t wake(uint32_t index) {
+        uint32_t awakeIndex = awakeCount++;
+        swapBodies(index, awakeIndex);
+        bodies.sleepTimer[awakeIndex] = 0.0f;
+        if (bodies.lodLevel[awakeIndex] == frozenLod) {
+            bodies.lodLevel[awakeIndex] = lodLevelCount - 1;
+        }
+        return awakeIndex;
+    }
+
+    // Moves an awake body out of the awake range like sleep, but keeps its velocity for
+    // when it thaws
+    void freeze(uint32_t index) {
+        uint32_t frozenIndex = --awakeCount;
+        swapBodies(index, frozenIndex);
+        bodies.lodLevel[frozenIndex] = frozenLod;
+        bodies.storePreviousState(frozenIndex, frozenIndex + 1);
+    }
+
+    // Moves an awake body to the start of the sleeping range and stops it
+    void sleep(uint32_t index) {
+        uint32_t sleepIndex = --awakeCount;
+        swapBodies(index, sleepIndex);
+        bodies.setVelocity(sleepIndex, glm::vec3(0.0f));
+        bodies.setAngularVelocity(sleepIndex, glm::vec3(0.0f));
+        // Previous state isn't stored while asleep, make sure it doesn't lag behind
+        bodies.storePreviousState(sleepIndex, sleepIndex + 1);
+    }
+
+    // Dense index of the body behind a handle the caller promises is valid
+    uint32_t indexOf(BodyHandle body) const {
+        assert(isValid(body) && "stale or invalid BodyHandle");
+        return handleToIndex[body.id];
+    }
+
+    // For setters, false for a stale handle the call has to ignore
+    bool checkHandle(BodyHandle body) const {
+        bool valid = isValid(body);
+        assert(valid && "stale or invalid BodyHandle");
+        return valid;
+    }
+
+    // Same for layer indices, which are shifts and layerMatrix indices
+    bool checkLayers(uint32_t layerA, uint32_t layerB) const {
+        bool valid = layerA < layerCount && layerB < layerCount;
+        assert(valid && "collision layer out of range");
+        return valid;
+    }
+
+    // Wakes the body if it sleeps and returns its dense index afterwards
+    uint32_t touchBody(BodyHandle body) {
+        uint32_t index = handleToIndex[body.id];
+        if (index >= awakeCount && !bodies.isStatic(index)) {
+            return wake(index);
+        }
+        bodies.sleepTimer[index] = 0.0f;
+        return index;
+    }
+
+    // Static bodies are never moved by the broadphase update, so refit them when teleported
+    void refitStatic(BodyHandle body) {
+        uint32_t index = handleToIndex[body.id];
+        if (bodies.isStatic(index) && tree.moveProxy(proxies[body.id], bodies.getAABB(index), glm::vec3(0.0f))) {
+            movedBodies.push_back(body.id);
+        }
+    }
+
+    // Thaws every frozen body and puts all of them back on the full rate
+    void resetLod() {
+        for (uint32_t i = awakeCount; i < bodies.size(); ++i) {
+            if (bodies.lodLevel[i] == frozenLod) {
+                wake(i);
+            }
+        }
+        for (size_t i = 0; i < bodies.size(); ++i) {
+            bodies.lodLevel[i] = 0;
+        }
+        lodStep = 0;
+    }
+
+    uint8_t computeLodLevel(const glm::vec3& position) const {
+        float closest = 1e30f;
+        for (size_t i = 0; i < lodFocusPoints.size(); ++i) {
+            glm::vec3 offset = position - lodFocusPoints[i];
+            closest = std::min(closest, glm::dot(offset, offset));
+        }
+        if (closest >= lodFreezeDistance * lodFreezeDistance) {
+            return frozenLod;
+        }
+        uint32_t level = 0;
+        while (level + 1 < lodLevelCount && closest >= lodDistances[level + 1] * lodDistances[level + 1]) {
+            ++level;
+        }
+        return (uint8_t)level;
+    }
+
+    // Rebuckets the bodies whenever every level steps together, so no body changes its
+    // rate halfway through one of its steps. Then fills the per body step arrays.
+    void prepareLodStep(float deltaTime) {
+        const uint32_t longestPeriod = 1u << (lodLevelCount - 1);
+        if (lodStep % longestPeriod == 0) {
+            lodFrozenBodies.clear();
+            lodThawedBodies.clear();
+            for (uint32_t i = 0; i < bodies.size(); ++i) {
+                if (bodies.isStatic(i)) {
+                    continue;
+                }
+                uint8_t level = computeLodLevel(bodies.getPosition(i));
+                if (level == frozenLod && i < awakeCount) {
+                    lodFrozenBodies.push_back(bodies.handles[i]);
+                }
+                else if (level != frozenLod && bodies.lodLevel[i] == frozenLod) {
+                    lodThawedBodies.push_back(bodies.handles[i]);
+                }
+                else if (bodies.lodLevel[i] != frozenLod) {
+                    // Sleeping bodies cost nothing already, they only freeze once awake
+                    bodies.lodLevel[i] = level == frozenLod ? (uint8_t)(lodLevelCount - 1) : level;
+                }
+            }
+
+            // Dense indices shift while the partition changes, so go through the handles
+            for (size_t i = 0; i < lodFrozenBodies.size(); ++i) {
+                freeze(handleToIndex[lodFrozenBodies[i]]);
+            }
+            for (size_t i = 0; i < lodThawedBodies.size(); ++i) {
+                uint32_t index = wake(handleToIndex[lodThawedBodies[i]]);
+                bodies.lodLevel[index] = computeLodLevel(bodies.getPosition(index));
+            }
+        }
+
+        // Levels that step advance by their whole period at once
+        float levelScale[lodLevelCount];
+        float levelLinearDamping[lodLevelCount];
+        float levelAngularDamping[lodLevelCount];
+        for (uint32_t level = 0; level < lodLevelCount; ++level) {
+            uint32_t period = 1u << level;
+            levelScale[level] = lodStep % period == 0 ? (float)period : 0.0f;
+            levelLinearDamping[level] = std::pow(linearDamping, levelScale[level]);
+            levelAngularDamping[level] = std::pow(angularDamping, levelScale[level]);
+        }
+
+        lodStepTime.resize(awakeCount);
+        lodLinearDamping.resize(awakeCount);
+        lodAngularDamping.resize(awakeCount);
+        lodRotationScale.resize(awakeCount);
+        for (uint32_t i = 0; i < awakeCount; ++i) {
+            uint8_t level = bodies.lodLevel[i];
+            lodStepTime[i] = deltaTime * levelScale[level];
+            lodLinearDamping[i] = levelLinearDamping[level];
+            lodAngularDamping[i] = levelAngularDamping[level];
+            lodRotationScale[i] = levelScale[level];
+        }
+        ++lodStep;
+    }
+
+    // Awake bodies that skip this step keep still and get no new contacts
+    bool isLodIdle(uint32_t index) const {
+        return !lodFocusPoints.empty() && index < awakeCount && lodStepTime[index] == 0.0f;
+    }
+
+    // Longer of the two time steps of a pair
+    float pairTimeStep(uint32_t a, uint32_t b, float deltaTime) const {
+        if (lodFocusPoints.empty()) {
+            return deltaTime;
+        }
+        float timeStep = deltaTime;
+        if (a < awakeCount) {
+            timeStep = std::max(timeStep, lodStepTime[a]);
+        }
+        if (b < awakeCount) {
+            timeStep = std::max(timeStep, lodStepTime[b]);
+        }
+        return timeStep;
+    }
+
+    // Same as integrateVelocities with the time step of every body taken from lodStepTime.
+    // Forces on bodies that skip the step wait for their next one.
+    void integrateVelocitiesLod(size_t end) {
+        const size_t width = SimdFloat::width;
+        const SimdFloat zero(0.0f);
+
+        bool withForces = forcesPending;
+        bool forcesKept = false;
+        size_t i = 0;
+        for (; i + width <= end; i += width) {
+            SimdFloat dt = SimdFloat::load(&lodStepTime[i]);
+            if (withForces) {
+                SimdFloat inverseMass = SimdFloat::load(&bodies.inverseMass[i]);
+                SimdFloat stepping = simdGreater(dt, zero);
+                forcesKept |= simdMoveMask(stepping) != (1 << width) - 1;
+                integrateVelocityAxisLod(&bodies.velocityX[i], &bodies.forceX[i], &bodies.gravityX[i], inverseMass, dt, stepping);
+                integrateVelocityAxisLod(&bodies.velocityY[i], &bodies.forceY[i], &bodies.gravityY[i], inverseMass, dt, stepping);
+                integrateVelocityAxisLod(&bodies.velocityZ[i], &bodies.forceZ[i], &bodies.gravityZ[i], inverseMass, dt, stepping);
+            }
+            else {
+                integrateVelocityAxis<false>(&bodies.velocityX[i], nullptr, &bodies.gravityX[i], SimdFloat(), dt);
+                integrateVelocityAxis<false>(&bodies.velocityY[i], nullptr, &bodies.gravityY[i], SimdFloat(), dt);
+                integrateVelocityAxis<false>(&bodies.velocityZ[i], nullptr, &bodies.gravityZ[i], SimdFloat(), dt);
+            }
+        }
+
+        for (; i < end; ++i) {
+            float dt = lodStepTime[i];
+            glm::vec3 acceleration = bodies.getGravity(i);
+            if (withForces && dt > 0.0f) {
+                acceleration += bodies.getForce(i) * bodies.inverseMass[i];
+                bodies.setForce(i, glm::vec3(0.0f));
+            }
+            forcesKept |= withForces && dt == 0.0f;
+            bodies.setVelocity(i, bodies.getVelocity(i) + acceleration * dt);
+        }
+        forcesPending = forcesKept;
+    }
+
+    void integratePositionsLod(size_t end) {
+        const size_t width = SimdFloat::width;
+
+        size_t i = 0;
+        for (; i + width <= end; i += width) {
+            SimdFloat dt = SimdFloat::load(&lodStepTime[i]);
+            SimdFloat linear = SimdFloat::load(&lodLinearDamping[i]);
+            SimdFloat angular = SimdFloat::load(&lodAngularDamping[i]);
+            SimdFloat rotationScale = SimdFloat::load(&lodRotationScale[i]);
+            integratePositionAxis(&bodies.positionX[i], &bodies.velocityX[i], dt, linear);
+            integratePositionAxis(&bodies.positionY[i], &bodies.velocityY[i], dt, linear);
+            integratePositionAxis(&bodies.positionZ[i], &bodies.velocityZ[i], dt, linear);
+            integrateRotationAxisLod(&bodies.rotationX[i], &bodies.angularVelocityX[i], angular, rotationScale);
+            integrateRotationAxisLod(&bodies.rotationY[i], &bodies.angularVelocityY[i], angular, rotationScale);
+            integrateRotationAxisLod(&bodies.rotationZ[i], &bodies.angularVelocityZ[i], angular, rotationScale);
+        }
+        bodies.updateOrientations(0, i);
+
+        for (; i < end; ++i) {
+            glm::vec3 velocity = bodies.getVelocity(i);
+            bodies.setPosition(i, bodies.getPosition(i) + velocity * lodStepTime[i]);
+            bodies.setVelocity(i, velocity * lodLinearDamping[i]);
+
+            glm::vec3 angularVelocity = bodies.getAngularVelocity(i) * lodAngularDamping[i];
+            bodies.setAngularVelocity(i, angularVelocity);
+            bodies.setRotation(i, bodies.getRotation(i) + angularVelocity * lodRotationScale[i]);
+        }
+    }
+
+    static void integrateVelocityAxisLod(float* velocity, float* force, const float* gravity, SimdFloat inverseMass, SimdFloat dt,
+        SimdFloat stepping) {
+        SimdFloat f = SimdFloat::load(force);
+        SimdFloat acceleration = SimdFloat::load(gravity) + f * inverseMass;
+        simdSelect(stepping, SimdFloat(0.0f), f).store(force);
+        (SimdFloat::load(velocity) + acceleration * dt).store(velocity);
+    }
+
+    static void integrateRotationAxisLod(float* rotation, float* angularVelocity, SimdFloat damping, SimdFloat scale) {
+        SimdFloat w = SimdFloat::load(angularVelocity) * damping;
+        w.store(angularVelocity);
+        (SimdFloat::load(rotation) + w * scale).store(rotation);
+    }
+
+    // Semi-implicit Euler over the body arrays, SimdFloat::width bodies at a time. Velocities
+    // are integrated before the contacts are solved, positions after, with the same math as
+    // Rigidbody::update when nothing touches.
+    void integrateVelocities(size_t begin, size_t end, float deltaTime) {
+        // Most steps have no external forces, skip streaming the force arrays then
+        if (forcesPending) {
+            integrateVelocities<true>(begin, end, deltaTime);
+            forcesPending = false;
+        }
+        else {
+            integrateVelocities<false>(begin, end, deltaTime);
+        }
+    }
+
+    template <bool withForces>
+    void integrateVelocities(size_t begin, size_t end, float deltaTime) {
+        const size_t width = SimdFloat::width;
+        const SimdFloat dt(deltaTime);
+
+        size_t i = begin;
+        for (; i + width <= end; i += width) {
+            SimdFloat inverseMass = withForces ? SimdFloat::load(&bodies.inverseMass[i]) : SimdFloat();
+            integrateVelocityAxis<withForces>(&bodies.velocityX[i], &bodies.forceX[i], &bodies.gravityX[i], inverseMass, dt);
+            integrateVelocityAxis<withForces>(&bodies.velocityY[i], &bodies.forceY[i], &bodies.gravityY[i], inverseMass, dt);
+            integrateVelocityAxis<withForces>(&bodies.velocityZ[i], &bodies.forceZ[i], &bodies.gravityZ[i], inverseMass, dt);
+        }
+
+        // Remaining bodies that don't fill a whole register
+        for (; i < end; ++i) {
+            glm::vec3 acceleration = bodies.getGravity(i);
+            if (withForces) {
+                acceleration += bodies.getForce(i) * bodies.inverseMass[i];
+                bodies.setForce(i, glm::vec3(0.0f));
+            }
+            bodies.setVelocity(i, bodies.getVelocity(i) + acceleration * deltaTime);
+        }
+    }
+
+    void integratePositions(size_t begin, size_t end, float deltaTime) {
+        const size_t width = SimdFloat::width;
+        const SimdFloat dt(deltaTime);
+        const SimdFloat linear(linearDamping);
+        const SimdFloat angular(angularDamping);
+
+        size_t i = begin;
+        for (; i + width <= end; i += width) {
+            integratePositionAxis(&bodies.positionX[i], &bodies.velocityX[i], dt, linear);
+            integratePositionAxis(&bodies.positionY[i], &bodies.velocityY[i], dt, linear);
+            integratePositionAxis(&bodies.positionZ[i], &bodies.velocityZ[i], dt, linear);
+            integrateRotationAxis(&bodies.rotationX[i], &bodies.angularVelocityX[i], angular);
+            integrateRotationAxis(&bodies.rotationY[i], &bodies.angularVelocityY[i], angular);
+            integrateRotationAxis(&bodies.rotationZ[i], &bodies.angularVelocityZ[i], angular);
+        }
+        bodies.updateOrientations(begin, i);
+
+        for (; i < end; ++i) {
+            glm::vec3 velocity = bodies.getVelocity(i);
+            bodies.setPosition(i, bodies.getPosition(i) + velocity * deltaTime);
+            bodies.setVelocity(i, velocity * linearDamping);
+
+            glm::vec3 angularVelocity = bodies.getAngularVelocity(i) * angularDamping;
+            bodies.setAngularVelocity(i, angularVelocity);
+            bodies.setRotation(i, bodies.getRotation(i) + angularVelocity);
+        }
+    }
+
+    template <bool withForces>
+    static void integrateVelocityAxis(float* velocity, float* force, const float* gravity, SimdFloat inverseMass, SimdFloat dt) {
+        SimdFloat acceleration = SimdFloat::load(gravity);
+        if (withForces) {
+            acceleration = acceleration + SimdFloat::load(force) * inverseMass;
+            SimdFloat(0.0f).store(force);
+        }
+        (SimdFloat::load(velocity) + acceleration * dt).store(velocity);
+    }
+
+    static void integratePositionAxis(float* position, float* velocity, SimdFloat dt, SimdFloat damping) {
+        SimdFloat v = SimdFloat::load(velocity);
+        (SimdFloat::load(position) + v * dt).store(position);
+        (v * damping).store(velocity);
+    }
+
+    static void integrateRotationAxis(float* rotation, float* angularVelocity, SimdFloat damping) {
+        SimdFloat w = SimdFloat::load(angularVelocity) * damping;
+        w.store(angularVelocity);
+        (SimdFloat::load(rotation) + w).store(rotation);
+    }
+
+    // Collider bounds, continuous bodies also cover where they move this step
+    AABB getBroadphaseAABB(uint32_t index, float deltaTime) const {
+        AABB box = bodies.getAABB(index);
+        if (bodies.continuous[index] && index < awakeCount) {
+            glm::vec3 displacement = bodies.getVelocity(index) * deltaTime;
+            box.min += glm::min(displacement, glm::vec3(0.0f));
+            box.max += glm::max(displacement, glm::vec3(0.0f));
+        }
+        return box;
+    }
+
+    void updateGridPairs(float deltaTime) {
+        // Re-bin every body, they have all moved since the last step
+        grid.clear();
+        for (size_t i = 0; i < bodies.size(); ++i) {
+            grid.insert((uint32_t)i, getBroadphaseAABB((uint32_t)i, deltaTime), bodies.collisionLayer[i], bodies.filterMask[i]);
+        }
+        grid.computePairs(candidatePairs);
+    }
+
+    void updateTreePairs(float deltaTime) {
+        // Only awake bodies that left their fat box get reinserted
+        for (size_t i = 0; i < awakeCount; ++i) {
+            if (isLodIdle((uint32_t)i)) {
+                continue;
+            }
+            // Bodies on a reduced rate move their whole period at once
+            float stepTime = lodFocusPoints.empty() ? deltaTime : lodStepTime[i];
+            uint32_t handle = bodies.handles[i];
+            if (tree.moveProxy(proxies[handle], getBroadphaseAABB((uint32_t)i, stepTime), bodies.getVelocity(i) * stepTime)) {
+                movedBodies.push_back(handle);
+            }
+        }
+
+        // Drop pairs of removed bodies and pairs whose fat boxes stopped overlapping
+        treePairs.erase(std::remove_if(treePairs.begin(), treePairs.end(), [&](const TreePair& pair) {
+            uint32_t first = handleToIndex[pair.first];
+            uint32_t second = handleToIndex[pair.second];
+            if (first == invalidIndex || second == invalidIndex) {
+                return true;
+            }
+            // Proxies of resting bodies and of bodies that skipped the step haven't moved
+            if ((first >= awakeCount || isLodIdle(first)) && (second >= awakeCount || isLodIdle(second))) {
+                return false;
+            }
+            return !tree.getFatAABB(proxies[pair.first]).overlaps(tree.getFatAABB(proxies[pair.second]));
+        }), treePairs.end());
+
+        // Moved bodies look for new partners
+        bool newPairs = !movedBodies.empty();
+        for (size_t i = 0; i < movedBodies.size(); ++i) {
+            uint32_t handle = movedBodies[i];
+            if (handleToIndex[handle] == invalidIndex) {
+                continue;
+            }
+
+            // Filtered pairs never make it into the list
+            uint32_t index = handleToIndex[handle];
+            int32_t proxy = proxies[handle];
+            tree.query(tree.getFatAABB(proxy), [&](int32_t other) {
+                uint32_t otherHandle = tree.getUserData(other);
+                if (other != proxy && bodies.canCollide(index, handleToIndex[otherHandle])) {
+                    treePairs.push_back(TreePair(handle, otherHandle));
+                }
+                return true;
+            });
+        }
+        movedBodies.clear();
+
+        // Removing pairs keeps the list sorted, only new pairs need sorting again
+        if (newPairs) {
+            std::sort(treePairs.begin(), treePairs.end());
+            treePairs.erase(std::unique(treePairs.begin(), treePairs.end()), treePairs.end());
+        }
+
+        candidatePairs.clear();
+        for (size_t i = 0; i < treePairs.size(); ++i) {
+            candidatePairs.push_back(std::make_pair(handleToIndex[treePairs[i].first], handleToIndex[treePairs[i].second]));
+        }
+    }
+
+    void addQueryCandidate(uint32_t index) {
+        if (bodies.colliderType[index] == (uint8_t)Rigidbody::ColliderType::Sphere) {
+            queryCandidates.addSphere(index, bodies.getPosition(index), bodies.radius[index]);
+        }
+        else if (bodies.colliderType[index] == (uint8_t)Rigidbody::ColliderType::Mesh || bodies.isOrientedBox(index)) {
+            // Meshes and oriented boxes are tested one by one afterwards
+            queryBodies.push_back(index);
+        }
+        else {
+            AABB box = bodies.getAABB(index);
+            queryCandidates.addBox(index, box.min, box.max);
+        }
+    }
+
+    // Gathers the shapes along the cast from the broadphase, then tests them in SIMD batches
+    bool castQuery(const glm::vec3& origin, const glm::vec3& direction, float radius, float maxDistance, RaycastHit& hit) {
+        queryCandidates.clear();
+        queryBodies.clear();
+        if (broadphaseType == BroadphaseType::DynamicTree) {
+            tree.sphereCast(origin, direction, radius, maxDistance, [&](int32_t proxy, float distance) {
+                addQueryCandidate(handleToIndex[tree.getUserData(proxy)]);
+                return distance;
+            });
+        }
+        else {
+            for (size_t i = 0; i < bodies.size(); ++i) {
+                addQueryCandidate((uint32_t)i);
+            }
+        }
+
+        hit.body = BodyHandle();
+        hit.distance = maxDistance;
+        QueryHit closest;
+        bool found = SceneQuery::castRay(queryCandidates, origin, direction, maxDistance, radius, closest);
+
+        // Bodies without a batched kernel are clipped to the closest batch hit, so any hit
+        // among them is the closer one
+        if (!queryBodies.empty()) {
+            hit.distance = found ? closest.distance : maxDistance;
+            bool bodyHit = false;
+            for (size_t i = 0; i < queryBodies.size(); ++i) {
+                bodyHit |= raycastBody(queryBodies[i], origin, direction, hit, radius);
+            }
+            if (bodyHit) {
+                return true;
+            }
+            hit.distance = maxDistance;
+        }
+        if (!found) {
+            return false;
+        }
+
+        // Normal and point only for the winner
+        glm::vec3 center = origin + direction * closest.distance;
+        if (closest.sphere) {
+            glm::vec3 offset = center - bodies.getPosition(closest.body);
+            float length = glm::length(offset);
+            hit.normal = length > 1e-6f ? offset / length : -direction;
+        }
+        else {
+            AABB box = bodies.getAABB(closest.body);
+            float distance;
+            if (!CollisionDetector::raycastBox(origin, direction, maxDistance, box.min - glm::vec3(radius), box.max + glm::vec3(radius), distance, hit.normal)) {
+                hit.normal = -direction;
+            }
+        }
+
+        hit.body = makeHandle(bodies.handles[closest.body]);
+        hit.distance = closest.distance;
+        hit.point = center - hit.normal * radius;
+        return true;
+    }
+
+    // Ray against one body, or a sphere of the radius swept along it. Boxes are grown by the
+    // radius and meshes only take rays.
+    bool raycastBody(uint32_t index, const glm::vec3& origin, const glm::vec3& direction, RaycastHit& hit, float radius = 0.0f) {
+        float distance;
+        glm::vec3 normal;
+
+        if (bodies.colliderType[index] == (uint8_t)Rigidbody::ColliderType::Sphere) {
+            glm::vec3 center = bodies.getPosition(index);
+            if (!CollisionDetector::raycastSphere(origin, direction, hit.distance, center, bodies.radius[index] + radius, distance)) {
+                return false;
+            }
+            glm::vec3 offset = origin + direction * distance - center;
+            float length = glm::length(offset);
+            normal = length > 1e-6f ? offset / length : -direction;
+        }
+        else if (bodies.colliderType[index] == (uint8_t)Rigidbody::ColliderType::Mesh) {
+            if (radius > 0.0f || !getMesh(index).raycast(origin, direction, hit.distance, distance, normal)) {
+                return false;
+            }
+        }
+        else if (bodies.isOrientedBox(index)) {
+            // Cast in the frame of the box, where it is axis aligned
+            OrientedBox box = bodies.getOrientedBox(index);
+            glm::vec3 grown = box.halfExtents + glm::vec3(radius);
+            glm::vec3 localDirection = box.toLocal(box.center + direction);
+            if (!CollisionDetector::raycastBox(box.toLocal(origin), localDirection, hit.distance, -grown, grown, distance, normal)) {
+                return false;
+            }
+            normal = box.toWorldDirection(normal);
+        }
+        else {
+            AABB box = bodies.getAABB(index);
+            if (!CollisionDetector::raycastBox(origin, direction, hit.distance, box.min - glm::vec3(radius), box.max + glm::vec3(radius), distance, normal)) {
+                return false;
+            }
+        }
+
+        hit.body = makeHandle(bodies.handles[index]);
+        hit.distance = distance;
+        hit.normal = normal;
+        hit.point = origin + direction * distance - normal * radius;
+        return true;
+    }
+
+    // Sphere volume against a body without a batched kernel
+    bool overlapsBody(uint32_t index, const glm::vec3& center, float radius) const {
+        if (bodies.colliderType[index] == (uint8_t)Rigidbody::ColliderType::Mesh) {
+            return getMesh(index).overlapsSphere(center, radius);
+        }
+        OrientedBox box = bodies.getOrientedBox(index);
+        glm::vec3 local = box.toLocal(center);
+        glm::vec3 offset = local - glm::clamp(local, -box.halfExtents, box.halfExtents);
+        return glm::dot(offset, offset) <= radius * radius;
+    }
+
+    // Sorts the candidate pairs into packed batches per shape pair and runs the batched kernels
+    void findContacts(float deltaTime) {
+        spherePairs.clear();
+        sphereBoxPairs.clear();
+        boxPairs.clear();
+        nextBoxPairCache.clear();
+        contacts.clear();
+
+        // Only the tree keeps its pairs from one step to the next, grid pairs are found anew
+        bool separationCache = broadphaseType == BroadphaseType::DynamicTree;
+
+        // Sort the pairs by shape first so every routine below runs over its own list
+        pairBuckets.clear();
+        for (size_t i = 0; i < candidatePairs.size(); ++i) {
+            uint32_t a = candidatePairs[i].first;
+            uint32_t b = candidatePairs[i].second;
+            // Resting bodies can't have new contacts between each other
+            if ((a >= awakeCount && b >= awakeCount) || isLodIdle(a) || isLodIdle(b)) {
+                continue;
+            }
+            if (separationCache && staysSeparated(treePairs[i], a, b, deltaTime)) {
+                continue;
+            }
+            pairBuckets.add(a, bodies.colliderType[a], b, bodies.colliderType[b], (uint32_t)i);
+        }
+
+        const std::vector<std::pair<uint32_t, uint32_t>>& spheres = pairBuckets[ShapePair::SphereSphere];
+        for (size_t i = 0; i < spheres.size(); ++i) {
+            uint32_t a = spheres[i].first;
+            uint32_t b = spheres[i].second;
+            spherePairs.add(a, bodies.getPosition(a), bodies.radius[a], b, bodies.getPosition(b), bodies.radius[b], pairMargin(a, b, deltaTime));
+        }
+
+        const std::vector<std::pair<uint32_t, uint32_t>>& sphereBoxes = pairBuckets[ShapePair::SphereBox];
+        for (size_t i = 0; i < sphereBoxes.size(); ++i) {
+            uint32_t sphere = sphereBoxes[i].first;
+            uint32_t box = sphereBoxes[i].second;
+            AABB boxBounds = bodies.getAABB(box);
+            sphereBoxPairs.add(sphere, bodies.getPosition(sphere), bodies.radius[sphere], box, boxBounds.min, boxBounds.max,
+                pairMargin(sphere, box, deltaTime));
+        }
+
+        const std::vector<std::pair<uint32_t, uint32_t>>& sphereOrientedBoxes = pairBuckets[ShapePair::SphereOrientedBox];
+        for (size_t i = 0; i < sphereOrientedBoxes.size(); ++i) {
+            uint32_t sphere = sphereOrientedBoxes[i].first;
+            uint32_t box = sphereOrientedBoxes[i].second;
+            Contact contact;
+            if (Narrowphase::collideSphereOrientedBox(sphere, bodies.getPosition(sphere), bodies.radius[sphere], box,
+                bodies.getOrientedBox(box), pairMargin(sphere, box, deltaTime), contact)) {
+                contacts.push_back(contact);
+            }
+        }
+
+        const std::vector<std::pair<uint32_t, uint32_t>>& sphereMeshes = pairBuckets[ShapePair::SphereMesh];
+        for (size_t i = 0; i < sphereMeshes.size(); ++i) {
+            collideSphereMesh(sphereMeshes[i].first, sphereMeshes[i].second, pairMargin(sphereMeshes[i].first, sphereMeshes[i].second, deltaTime));
+        }
+
+        const std::vector<std::pair<uint32_t, uint32_t>>& boxes = pairBuckets[ShapePair::BoxBox];
+        for (size_t i = 0; i < boxes.size(); ++i) {
+            collideBoxPair(boxes[i].first, boxes[i].second, pairMargin(boxes[i].first, boxes[i].second, deltaTime));
+        }
+
+        Narrowphase::collideSpheres(spherePairs, contacts, separationCache ? &pairSeparations : nullptr);
+        if (separationCache) {
+            storeSeparations(pairBuckets.getSources(ShapePair::SphereSphere));
+        }
+        Narrowphase::collideSphereBoxes(sphereBoxPairs, contacts, separationCache ? &pairSeparations : nullptr);
+        if (separationCache) {
+            storeSeparations(pairBuckets.getSources(ShapePair::SphereBox));
+        }
+
+        // Box pairs the cache couldn't settle run the full test, their results refill the cache
+        Narrowphase::collideBoxes(boxPairs, contacts, boxPairResults);
+        for (size_t i = 0; i < boxPairs.size(); ++i) {
+            uint32_t a = boxPairs.bodyA[i];
+            uint32_t b = boxPairs.bodyB[i];
+            const BoxPairResult& result = boxPairResults[i];
+
+            BoxPairCache entry;
+            entry.key = pairKey(bodies.handles[a], bodies.handles[b]);
+            entry.offset = glm::vec3(boxPairs.centerBX[i] - boxPairs.centerAX[i], boxPairs.centerBY[i] - boxPairs.centerAY[i],
+                boxPairs.centerBZ[i] - boxPairs.centerAZ[i]);
+            entry.rotationA = bodies.getRotation(a);
+            entry.rotationB = bodies.getRotation(b);
+            entry.separation = result.separation;
+            entry.gap = result.gap;
+            entry.axis = result.axis;
+            entry.separated = result.separated;
+            nextBoxPairCache.push_back(entry);
+        }
+        std::sort(nextBoxPairCache.begin(), nextBoxPairCache.end());
+        boxPairCache.swap(nextBoxPairCache);
+    }
+
+    // Continuous pairs look ahead by how far they can close in on each other this step
+    float pairMargin(uint32_t a, uint32_t b, float deltaTime) const {
+        if (bodies.continuous[a] || bodies.continuous[b]) {
+            return glm::length(bodies.getVelocity(b) - bodies.getVelocity(a)) * pairTimeStep(a, b, deltaTime);
+        }
+        return 0.0f;
+    }
+
+    static uint64_t pairKey(uint32_t handleA, uint32_t handleB) {
+        return ((uint64_t)handleA << 32) | handleB;
+    }
+
+    // Whether the pair is still as far apart as its margin, see TreePair. a and b are the
+    // dense indices of its first and second body.
+    bool staysSeparated(const TreePair& pair, uint32_t a, uint32_t b, float deltaTime) const {
+        if (pair.separation <= 0.0f) {
+            return false;
+        }
+        float reach = pair.separation - pairMargin(a, b, deltaTime);
+        glm::vec3 moved = bodies.getPosition(b) - bodies.getPosition(a) - pair.offset;
+        return reach > 0.0f && glm::dot(moved, moved) < reach * reach;
+    }
+
+    // Keeps what the last batched test measured for each of its pairs, sources are their
+    // tree pair indices in batch order
+    void storeSeparations(const std::vector<uint32_t>& sources) {
+        for (size_t i = 0; i < sources.size(); ++i) {
+            TreePair& pair = treePairs[sources[i]];
+            pair.offset = bodies.getPosition(handleToIndex[pair.second]) - bodies.getPosition(handleToIndex[pair.first]);
+            pair.separation = pairSeparations[i];
+        }
+    }
+
+    // Box pairs mostly keep their separating axis from one step to the next. While neither
+    // box turned, no axis can gain more on another than twice the distance the boxes moved
+    // relative to each other, so the cached axis is still the right one until that distance
+    // eats up its lead. Pairs outside of that bound go to the batched full test.
+    void collideBoxPair(uint32_t a, uint32_t b, float margin) {
+        // Same order every step, so the cached axis refers to the same boxes
+        if (bodies.handles[a] > bodies.handles[b]) {
+            std::swap(a, b);
+        }
+        OrientedBox boxA = bodies.getOrientedBox(a);
+        OrientedBox boxB = bodies.getOrientedBox(b);
+
+        BoxPairCache probe;
+        probe.key = pairKey(bodies.handles[a], bodies.handles[b]);
+        std::vector<BoxPairCache>::const_iterator cached = std::lower_bound(boxPairCache.begin(), boxPairCache.end(), probe);
+        if (cached != boxPairCache.end() && cached->key == probe.key &&
+            cached->rotationA == bodies.getRotation(a) && cached->rotationB == bodies.getRotation(b)) {
+            float moved = glm::length(boxB.center - boxA.center - cached->offset);
+
+            if (cached->separated && cached->separation - moved > margin) {
+                nextBoxPairCache.push_back(*cached);
+                return;
+            }
+
+            float separation;
+            if (!cached->separated && 2.0f * moved < cached->gap && Narrowphase::boxSeparation(boxA, boxB, cached->axis, separation)) {
+                if (separation <= margin) {
+                    contacts.push_back(Narrowphase::boxContact(a, boxA, b, boxB, cached->axis, separation));
+                }
+                nextBoxPairCache.push_back(*cached);
+                return;
+            }
+        }
+
+        boxPairs.add(a, boxA, b, boxB, margin);
+    }
+
+    // The mesh walks its own hierarchy, so these pairs skip the batched kernels
+    void collideSphereMesh(uint32_t sphere, uint32_t mesh, float margin) {
+        meshContacts.clear();
+        getMesh(mesh).collideSphere(bodies.getPosition(sphere), bodies.radius[sphere], margin, meshContacts);
+        for (size_t i = 0; i < meshContacts.size(); ++i) {
+            Contact contact;
+            contact.bodyA = mesh;
+            contact.bodyB = sphere;
+            contact.normal = meshContacts[i].normal;
+            contact.depth = meshContacts[i].depth;
+            contact.point = meshContacts[i].point;
+            contact.type = ContactType::SphereMesh;
+            contacts.push_back(contact);
+        }
+    }
+
+    const MeshCollider& getMesh(uint32_t index) const {
+        return *meshColliders[bodyMeshes[bodies.handles[index]]];
+    }
+
+    // Safety net behind the speculative contacts. A continuous sphere that still moved into a
+    // box this step is pulled back to the time of impact and loses the velocity into the box.
+    // Meshes have no sphere sweep and only get the speculative contacts.
+    void sweepContinuousBodies() {
+        for (uint32_t i = 0; i < awakeCount; ++i) {
+            if (!bodies.continuous[i] || bodies.colliderType[i] != (uint8_t)Rigidbody::ColliderType::Sphere) {
+                continue;
+            }
+
+            // Slow bodies can't skip over anything the discrete contacts would miss
+            glm::vec3 start = bodies.getPreviousPosition(i);
+            glm::vec3 end = bodies.getPosition(i);
+            float radius = bodies.radius[i];
+            glm::vec3 motion = end - start;
+            if (glm::dot(motion, motion) < radius * radius * 0.25f) {
+                continue;
+            }
+
+            AABB swept(glm::min(start, end) - glm::vec3(radius), glm::max(start, end) + glm::vec3(radius));
+            queryOverlap(swept, touchingBodies);
+
+            float firstFraction = 1.0f;
+            glm::vec3 firstNormal(0.0f);
+            for (size_t j = 0; j < touchingBodies.size(); ++j) {
+                uint32_t other = handleToIndex[touchingBodies[j].id];
+                if (other == i || !bodies.canCollide(i, other)) {
+                    continue;
+                }
+
+                float fraction;
+                glm::vec3 normal;
+                if (bodies.isOrientedBox(other)) {
+                    // Sweep in the frame of the box, where it is axis aligned
+                    OrientedBox box = bodies.getOrientedBox(other);
+                    if (!CollisionDetector::sweepSphereBox(box.toLocal(start), box.toLocal(end), radius, -box.halfExtents, box.halfExtents, fraction, normal)) {
+                        continue;
+                    }
+                    normal = box.toWorldDirection(normal);
+                }
+                else if (bodies.colliderType[other] == (uint8_t)Rigidbody::ColliderType::BoundingBox) {
+                    AABB box = bodies.getAABB(other);
+                    if (!CollisionDetector::sweepSphereBox(start, end, radius, box.min, box.max, fraction, normal)) {
+                        continue;
+                    }
+                }
+                else {
+                    continue;
+                }
+
+                if (fraction < firstFraction) {
+                    firstFraction = fraction;
+                    firstNormal = normal;
+                }
+            }
+
+            if (firstFraction < 1.0f) {
+                bodies.setPosition(i, start + motion * firstFraction);
+                glm::vec3 velocity = bodies.getVelocity(i);
+                bodies.setVelocity(i, velocity - std::min(glm::dot(velocity, firstNormal), 0.0f) * firstNormal);
+            }
+        }
+    }
+
+    uint32_t findRoot(uint32_t body) {
+        while (islandParent[body] != body) {
+            // Path halving
+            islandParent[body] = islandParent[islandParent[body]];
+            body = islandParent[body];
+        }
+        return body;
+    }
+
+    // Groups the contacts into islands of bodies connected through contacts. Static bodies
+    // are never written by the solver, so they don't join the islands they touch.
+    void buildIslands() {
+        uint32_t bodyCount = (uint32_t)bodies.size();
+        islandParent.resize(bodyCount);
+        for (uint32_t i = 0; i < bodyCount; ++i) {
+            islandParent[i] = i;
+        }
+
+        for (size_t i = 0; i < contacts.size(); ++i) {
+            uint32_t a = contacts[i].bodyA;
+            uint32_t b = contacts[i].bodyB;
+            if (bodies.isStatic(a) || bodies.isStatic(b)) {
+                continue;
+            }
+
+            // Lower index becomes the root, so the forest only depends on the contact order
+            uint32_t rootA = findRoot(a);
+            uint32_t rootB = findRoot(b);
+            if (rootA != rootB) {
+                islandParent[std::max(rootA, rootB)] = std::min(rootA, rootB);
+            }
+        }
+
+        // Islands are numbered in order of their first contact, which keeps the
+        // numbering independent of how the islands get solved
+        rootIsland.assign(bodyCount, invalidIndex);
+        contactIsland.resize(contacts.size());
+        uint32_t islandCount = 0;
+        for (size_t i = 0; i < contacts.size(); ++i) {
+            uint32_t body = bodies.isStatic(contacts[i].bodyA) ? contacts[i].bodyB : contacts[i].bodyA;
+            uint32_t root = findRoot(body);
+            if (rootIsland[root] == invalidIndex) {
+                rootIsland[root] = islandCount++;
+            }
+            contactIsland[i] = rootIsland[root];
+        }
+
+        // Stable counting sort keeps the contacts of an island in their original order
+        islandContactStart.assign(islandCount + 1, 0);
+        for (size_t i = 0; i < contacts.size(); ++i) {
+            ++islandContactStart[contactIsland[i] + 1];
+        }
+        for (uint32_t i = 0; i < islandCount; ++i) {
+            islandContactStart[i + 1] += islandContactStart[i];
+        }
+
+        // rootIsland isn't needed anymore, reuse it as the write cursor of every island
+        islandContacts.resize(contacts.size());
+        std::vector<uint32_t>& cursor = rootIsland;
+        std::copy(islandContactStart.begin(), islandContactStart.end() - 1, cursor.begin());
+        for (size_t i = 0; i < contacts.size(); ++i) {
+            islandContacts[cursor[contactIsland[i]]++] = (uint32_t)i;
+        }
+    }
+
+    // Islands share no dynamic bodies, so each one is solved sequentially by a single job
+    // and the result is the same for any number of threads
+    void solveIslands(float deltaTime) {
+        if (lodFocusPoints.empty()) {
+            solver.prepare(bodies, contacts, deltaTime);
+        }
+        else {
+            solver.prepare(bodies, contacts, deltaTime, lodStepTime.data(), awakeCount);
+        }
+
+        uint32_t islandCount = (uint32_t)getIslandCount();
+        auto solveRange = [this](uint32_t begin, uint32_t end) {
+            for (uint32_t island = begin; island < end; ++island) {
+                uint32_t first = islandContactStart[island];
+                solver.solve(bodies, islandContacts.data() + first, islandContactStart[island + 1] - first);
+            }
+        };
+
+        // A few chunks per thread so stealing can even out islands of different sizes
+        const size_t minParallelContacts = 256;
+        if (contacts.size() < minParallelContacts) {
+            solveRange(0, islandCount);
+        }
+        else {
+            uint32_t grainSize = std::max(1u, islandCount / ((jobSystem->getWorkerCount() + 1) * 4));
+            jobSystem->parallelFor(islandCount, grainSize, solveRange);
+        }
+        if (lodFocusPoints.empty()) {
+            solver.storeImpulses(bodies, handleToIndex, awakeCount);
+        }
+        else {
+            solver.storeImpulses(bodies, handleToIndex, awakeCount, lodStepTime.data(), awakeCount);
+        }
+    }
+
+    // Advances the sleep timers and puts islands to sleep whose bodies all rested long enough.
+    // Sleeping bodies touched by an awake body this step are woken up instead.
+    void updateSleep(float deltaTime) {
+        if (!sleepingEnabled) {
+            return;
+        }
+
+        float linearLimit = linearSleepVelocity * linearSleepVelocity;
+        float angularLimit = angularSleepVelocity * angularSleepVelocity;
+        islandSleepTimer.assign(bodies.size(), 1e30f);
+        for (uint32_t i = 0; i < awakeCount; ++i) {
+            // Bodies that skipped the step have no contacts to tell their island apart, they
+            // wait for their next step to decide
+            if (isLodIdle(i)) {
+                islandSleepTimer[findRoot(i)] = 0.0f;
+                continue;
+            }
+
+            glm::vec3 velocity = bodies.getVelocity(i);
+            glm::vec3 angularVelocity = bodies.getAngularVelocity(i);
+            if (glm::dot(velocity, velocity) > linearLimit || glm::dot(angularVelocity, angularVelocity) > angularLimit) {
+                bodies.sleepTimer[i] = 0.0f;
+            }
+            else {
+                bodies.sleepTimer[i] += lodFocusPoints.empty() ? deltaTime : lodStepTime[i];
+            }
+
+            uint32_t root = findRoot(i);
+            islandSleepTimer[root] = std::min(islandSleepTimer[root], bodies.sleepTimer[i]);
+        }
+
+        // Awake bodies share an island with the sleeping bodies they touch, keep it awake
+        wokenBodies.clear();
+        for (size_t i = 0; i < contacts.size(); ++i) {
+            uint32_t a = contacts[i].bodyA;
+            uint32_t b = contacts[i].bodyB;
+            uint32_t resting = a >= awakeCount ? a : b;
+            if (resting >= awakeCount && !bodies.isStatic(resting) && bodies.lodLevel[resting] != frozenLod) {
+                islandSleepTimer[findRoot(resting)] = 0.0f;
+                wokenBodies.push_back(bodies.handles[resting]);
+            }
+        }
+
+        sleepingBodies.clear();
+        for (uint32_t i = 0; i < awakeCount; ++i) {
+            if (islandSleepTimer[findRoot(i)] >= timeToSleep) {
+                sleepingBodies.push_back(bodies.handles[i]);
+            }
+        }
+
+        // Dense indices shift while the partition changes, so go through the handles
+        for (size_t i = 0; i < sleepingBodies.size(); ++i) {
+            sleep(handleToIndex[sleepingBodies[i]]);
+        }
+        for (size_t i = 0; i < wokenBodies.size(); ++i) {
+            uint32_t index = handleToIndex[wokenBodies[i]];
+            if (index >= awakeCount) {
+                wake(index);
+            }
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,305 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <mesh.h>
+#include <model.h>
+#include <Shader.h>
+
+#include <vector>
+#include <algorithm>
+#include <utility>
+#include <cstdint>
+
+// Index of a mesh registered with a RenderQueue
+struct MeshHandle {
+    uint32_t index;
+};
+
+// Meshes of a registered model, they take consecutive mesh handles
+struct ModelHandle {
+    uint32_t firstMesh;
+    uint32_t meshCount;
+};
+
+// Everything a pass binds before drawing an item besides the mesh itself
+struct RenderMaterial {
+    unsigned int diffuseTexture = 0;
+    // Drawn back to front with blending after everything opaque
+    bool blended = false;
+    // Program the item is drawn with, null for the shader the pass was given. Per frame
+    // uniforms like the view matrix have to be set on it before the pass.
+    Shader* shader = nullptr;
+};
+
+struct MaterialHandle {
+    uint32_t index;
+};
+
+// One mesh to draw at one of the transforms of the frame
+struct DrawItem {
+    // Draw order, see RenderQueue::MakeKey
+    uint64_t key;
+    uint32_t mesh;
+    uint32_t material;
+    uint32_t transform;
+    bool castsShadow;
+};
+
+// Collects the draw items of a frame once, every pass then draws from the same list.
+// Meshes and materials are registered up front and referenced by handle, so submitting
+// copies nothing but a few indices. Items are radix sorted by a 64 bit key so state changes
+// only happen where the key changes, and items of the same mesh and material that end up
+// next to each other are drawn with one instanced call. Clear keeps every buffer's
+// capacity, so a frame with no more items than earlier ones doesn't allocate.
+class RenderQueue {
+public:
+    static const int shaderBits = 8;
+    static const int materialBits = 16;
+    static const int meshBits = 16;
+    static const int depthBits = 23;
+
+    RenderQueue() : viewPosition(0.0f), farDistance(100.0f), sorted(true)
+    {
+        instancedUniform = Shader::GetUniformID("instanced");
+        diffuseTextureUniform = Shader::GetUniformID("diffuseTexture");
+        // Slot 0 stands for the shader given to the pass
+        shaders.push_back(nullptr);
+    }
+
+    // The mesh has to stay where it is for as long as the queue is used
+    MeshHandle AddMesh(Mesh& mesh)
+    {
+        meshes.push_back(&mesh);
+        return MeshHandle{ (uint32_t)meshes.size() - 1 };
+    }
+
+    ModelHandle AddModel(Model& model)
+    {
+        ModelHandle handle{ (uint32_t)meshes.size(), (uint32_t)model.meshes.size() };
+        for (size_t i = 0; i < model.meshes.size(); i++)
+            AddMesh(model.meshes[i]);
+        return handle;
+    }
+
+    MaterialHandle AddMaterial(const RenderMaterial& material)
+    {
+        materials.push_back(material);
+        materialShaders.push_back(FindShaderSlot(material.shader));
+        return MaterialHandle{ (uint32_t)materials.size() - 1 };
+    }
+
+    const RenderMaterial& GetMaterial(MaterialHandle material) const
+    {
+        return materials[material.index];
+    }
+
+    // Starts a new frame seen from the camera position. Depth in the sort keys is the
+    // distance to it, clamped at farDistance.
+    void Clear(const glm::vec3& cameraPosition, float cameraFarDistance)
+    {
+        viewPosition = cameraPosition;
+        farDistance = cameraFarDistance;
+        transforms.clear();
+        items.clear();
+        sorted = true;
+    }
+
+    // Returns the index items refer to the transform by
+    uint32_t AddTransform(const glm::mat4& transform)
+    {
+        transforms.push_back(transform);
+        return (uint32_t)transforms.size() - 1;
+    }
+
+    void Submit(MeshHandle mesh, MaterialHandle material, uint32_t transform, bool castsShadow = true)
+    {
+        DrawItem item;
+        item.mesh = mesh.index;
+        item.material = material.index;
+        item.transform = transform;
+        item.castsShadow = castsShadow;
+        item.key = MakeKey(item);
+        items.push_back(item);
+        sorted = false;
+    }
+
+    // Submits every mesh of the model at a new transform
+    void Submit(ModelHandle model, MaterialHandle material, const glm::mat4& transform, bool castsShadow = true)
+    {
+        uint32_t transformIndex = AddTransform(transform);
+        for (uint32_t i = 0; i < model.meshCount; i++)
+            Submit(MeshHandle{ model.firstMesh + i }, material, transformIndex, castsShadow);
+    }
+
+    size_t GetItemCount() const
+    {
+        return items.size();
+    }
+
+    // Draws the opaque items front to back, then the blended ones back to front with
+    // blending and without depth writes. The shader has to be in use.
+    void Draw(Shader& shader)
+    {
+        DrawItems(shader, false);
+    }
+
+    // Draws the items that cast shadows without binding materials, for depth only passes
+    void DrawShadowCasters(Shader& shader)
+    {
+        DrawItems(shader, true);
+    }
+
+private:
+    std::vector<Mesh*> meshes;
+    std::vector<RenderMaterial> materials;
+    // Shader slot of every material
+    std::vector<uint32_t> materialShaders;
+    std::vector<Shader*> shaders;
+
+    glm::vec3 viewPosition;
+    float farDistance;
+    std::vector<glm::mat4> transforms;
+    std::vector<DrawItem> items;
+    // Radix sort scatters into here and swaps
+    std::vector<DrawItem> sortScratch;
+    bool sorted;
+    // Model matrices of the run of items drawn next
+    std::vector<glm::mat4> instanceModels;
+    UniformID instancedUniform;
+    UniformID diffuseTextureUniform;
+
+    uint32_t FindShaderSlot(Shader* shader)
+    {
+        for (size_t i = 0; i < shaders.size(); i++)
+        {
+            if (shaders[i] == shader)
+                return (uint32_t)i;
+        }
+        shaders.push_back(shader);
+        return (uint32_t)shaders.size() - 1;
+    }
+
+    static uint64_t Field(uint64_t value, int bits)
+    {
+        return value & ((1ull << bits) - 1);
+    }
+
+    // From the highest bit down: blended, then for opaque items shader, material, mesh and
+    // depth, so state changes are rare and each state group is drawn front to back for
+    // early depth rejection. Blended items put depth right after the blended bit instead,
+    // inverted, so they come out back to front whatever their state.
+    uint64_t MakeKey(const DrawItem& item) const
+    {
+        glm::vec3 position(transforms[item.transform][3]);
+        float distance = glm::length(position - viewPosition) / farDistance;
+        uint64_t depth = (uint64_t)(std::min(std::max(distance, 0.0f), 1.0f) * (float)((1u << depthBits) - 1));
+
+        uint64_t shader = Field(materialShaders[item.material], shaderBits);
+        uint64_t material = Field(item.material, materialBits);
+        uint64_t mesh = Field(item.mesh, meshBits);
+        if (!materials[item.material].blended)
+        {
+            return (shader << (materialBits + meshBits + depthBits)) | (material << (meshBits + depthBits)) |
+                (mesh << depthBits) | depth;
+        }
+
+        uint64_t farToNear = ((1u << depthBits) - 1) - depth;
+        return (1ull << 63) | (farToNear << (shaderBits + materialBits + meshBits)) |
+            (shader << (materialBits + meshBits)) | (material << meshBits) | mesh;
+    }
+
+    // Least significant digit first radix sort over 8 bit digits. Digits every key shares,
+    // usually most of the shader and material bits, are skipped without moving anything.
+    void Sort()
+    {
+        if (sorted || items.empty())
+            return;
+        sortScratch.resize(items.size());
+
+        for (int shift = 0; shift < 64; shift += 8)
+        {
+            size_t counts[256] = {};
+            for (size_t i = 0; i < items.size(); i++)
+                counts[(items[i].key >> shift) & 0xFF]++;
+            if (counts[(items[0].key >> shift) & 0xFF] == items.size())
+                continue;
+
+            size_t offset = 0;
+            for (int digit = 0; digit < 256; digit++)
+            {
+                size_t count = counts[digit];
+                counts[digit] = offset;
+                offset += count;
+            }
+            for (size_t i = 0; i < items.size(); i++)
+                sortScratch[counts[(items[i].key >> shift) & 0xFF]++] = items[i];
+            items.swap(sortScratch);
+        }
+        sorted = true;
+    }
+
+    void DrawItems(Shader& passShader, bool shadowCastersOnly)
+    {
+        Sort();
+
+        Shader* current = &passShader;
+        current->setBool(instancedUniform, true);
+        uint32_t boundMaterial = UINT32_MAX;
+        bool blending = false;
+
+        size_t begin = 0;
+        while (begin < items.size())
+        {
+            // Gather the run of items sharing mesh and material
+            const DrawItem& first = items[begin];
+            size_t end = begin;
+            instanceModels.clear();
+            while (end < items.size() && items[end].mesh == first.mesh && items[end].material == first.material)
+            {
+                if (!shadowCastersOnly || items[end].castsShadow)
+                    instanceModels.push_back(transforms[items[end].transform]);
+                end++;
+            }
+            begin = end;
+            if (instanceModels.empty())
+                continue;
+
+            // Depth only passes keep their own shader and ignore materials
+            if (!shadowCastersOnly && first.material != boundMaterial)
+            {
+                const RenderMaterial& material = materials[first.material];
+                Shader* shader = material.shader ? material.shader : &passShader;
+                if (shader != current)
+                {
+                    current->setBool(instancedUniform, false);
+                    current = shader;
+                    current->use();
+                    current->setBool(instancedUniform, true);
+                }
+                if (material.blended && !blending)
+                {
+                    glEnable(GL_BLEND);
+                    glDepthMask(GL_FALSE);
+                    blending = true;
+                }
+                current->setTexture2D(diffuseTextureUniform, material.diffuseTexture, 0);
+                boundMaterial = first.material;
+            }
+            meshes[first.mesh]->DrawInstanced(*current, instanceModels.data(), (unsigned int)instanceModels.size());
+        }
+
+        if (blending)
+        {
+            glDisable(GL_BLEND);
+            glDepthMask(GL_TRUE);
+        }
+        current->setBool(instancedUniform, false);
+        if (current != &passShader)
+            passShader.use();
+    }
+};
+
+#endif
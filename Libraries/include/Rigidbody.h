@@ -5,16 +5,19 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtx/rotate_vector.hpp>
 #include <model.h>
+#include <AABB.h>
+#include <Transform.h>
+#include <OrientedBox.h>
 
 class Rigidbody {
 private:
-    glm::vec3 position;
+    // Position and rotation, caches the model matrix
+    Transform transform;
     glm::vec3 velocity;
     glm::vec3 acceleration;
     glm::vec3 force;
     float mass;
     glm::vec3 gravity;
-    glm::vec3 rotation;
     glm::vec3 angularVelocity;
     glm::mat3 inertiaTensor; 
 
@@ -22,30 +25,57 @@ private:
     glm::vec3 boundingBoxMin;
     glm::vec3 boundingBoxMax;
     glm::vec3 colliderRotation;
+    // Bounding box with the collider rotation applied, rebuilt when the rotation changes
+    glm::vec3 rotatedBoundingBoxMin;
+    glm::vec3 rotatedBoundingBoxMax;
 
     float radius;
 
+    // Static bodies never move and have infinite mass in the physics world
+    bool staticBody;
+    // Fast bodies that get swept collision tests in the physics world
+    bool continuousCollision;
+
+    // Layers the body is on and layers it collides with, one bit per layer
+    uint32_t collisionLayer = 1u;
+    uint32_t collisionMask = 0xFFFFFFFFu;
+
 public:
     Rigidbody(glm::vec3 initialPosition, float initialMass, glm::vec3 initialGravity,
         Model& model, glm::vec3 initialRotation)
-        : position(initialPosition), mass(initialMass), velocity(glm::vec3(0.0f)),
+        : transform(initialPosition, initialRotation), mass(initialMass), velocity(glm::vec3(0.0f)),
         acceleration(glm::vec3(0.0f)), force(glm::vec3(0.0f)), gravity(initialGravity),
-        rotation(initialRotation), angularVelocity(glm::vec3(0.0f)), // Initialize angular velocity
+        angularVelocity(glm::vec3(0.0f)), // Initialize angular velocity
         inertiaTensor(glm::mat3(1.0f)), // Initialize inertia tensor
-        colliderType(ColliderType::BoundingBox) {
+        colliderRotation(glm::vec3(0.0f)), staticBody(false), continuousCollision(false), colliderType(ColliderType::BoundingBox) {
         // Get bounding box from the model
         boundingBoxMax = model.GetMaxBoundingBox();
         boundingBoxMin = model.GetMinBoundingBox();
+        updateRotatedBoundingBox();
+    }
+
+    // Constructor for a bounding box collider with explicit bounds, for bodies without a model
+    Rigidbody(glm::vec3 initialPosition, float initialMass, glm::vec3 initialGravity,
+        glm::vec3 initialBoundingBoxMin, glm::vec3 initialBoundingBoxMax, glm::vec3 initialRotation = glm::vec3(0.0f))
+        : transform(initialPosition, initialRotation), velocity(glm::vec3(0.0f)), acceleration(glm::vec3(0.0f)),
+        force(glm::vec3(0.0f)), mass(initialMass), gravity(initialGravity),
+        angularVelocity(glm::vec3(0.0f)), inertiaTensor(glm::mat3(1.0f)),
+        boundingBoxMin(initialBoundingBoxMin), boundingBoxMax(initialBoundingBoxMax), colliderRotation(glm::vec3(0.0f)),
+        radius(0.0f), staticBody(false), continuousCollision(false), colliderType(ColliderType::BoundingBox) {
+        updateRotatedBoundingBox();
     }
 
     // Constructor for spherical collider
     Rigidbody(glm::vec3 initialPosition, float initialMass, glm::vec3 initialGravity,
         float initialRadius)
-        : position(initialPosition), mass(initialMass), velocity(glm::vec3(0.0f)),
+        : transform(initialPosition), mass(initialMass), velocity(glm::vec3(0.0f)),
         acceleration(glm::vec3(0.0f)), force(glm::vec3(0.0f)), gravity(initialGravity),
-        rotation(glm::vec3(0.0f)), angularVelocity(glm::vec3(0.0f)), // Initialize angular velocity
+        angularVelocity(glm::vec3(0.0f)), // Initialize angular velocity
         inertiaTensor((2.0f / 5.0f)* initialMass* initialRadius* initialRadius* glm::mat3(1.0f)), // Spherical inertia tensor
-        radius(initialRadius), colliderType(ColliderType::Sphere) {}
+        boundingBoxMin(glm::vec3(-initialRadius)), boundingBoxMax(glm::vec3(initialRadius)), colliderRotation(glm::vec3(0.0f)),
+        radius(initialRadius), staticBody(false), continuousCollision(false), colliderType(ColliderType::Sphere) {
+        updateRotatedBoundingBox();
+    }
 
     void applyForce(glm::vec3 externalForce) {
         force += externalForce;
@@ -62,26 +92,30 @@ public:
         velocity += acceleration * deltaTime;
 
         // Update position
-        position += velocity * deltaTime;
+        transform.setPosition(transform.getPosition() + velocity * deltaTime);
 
         // Update rotation based on angular velocity
         angularVelocity *= 0.8f;
         velocity *= 0.98f;
 
-        rotation += angularVelocity;
+        transform.setRotation(transform.getRotation() + angularVelocity);
 
         // Reset force for next update
         force = glm::vec3(0.0f);
     }
 
     glm::vec3 getPosition() const {
-        return position;
+        return transform.getPosition();
     }
 
     glm::vec3 getVelocity() const {
         return velocity;
     }
 
+    glm::vec3 getForce() const {
+        return force;
+    }
+
     glm::vec3 getAngularVelocity() const {
         return angularVelocity;
     }
@@ -92,7 +126,7 @@ public:
     }
 
     void setPosition(glm::vec3 newPosition) {
-        position = newPosition;
+        transform.setPosition(newPosition);
     }
 
     void setVelocity(glm::vec3 newVelocity) {
@@ -120,43 +154,121 @@ public:
     }
 
     glm::vec3 getRotation() const {
-        return rotation;
+        return transform.getRotation();
     }
 
     void setRotation(glm::vec3 newRotation) {
-        rotation = newRotation;
+        transform.setRotation(newRotation);
+    }
+
+    Transform& getTransform() {
+        return transform;
+    }
+
+    const Transform& getTransform() const {
+        return transform;
     }
 
     void setColliderRotation(const glm::vec3& newRotation) {
         colliderRotation = newRotation;
+        updateRotatedBoundingBox();
     }
 
-    float getRadius() {
+    float getRadius() const {
         return radius;
     }
 
+    bool isStatic() const {
+        return staticBody;
+    }
+
+    void setStatic(bool newStatic) {
+        staticBody = newStatic;
+    }
+
+    bool isContinuous() const {
+        return continuousCollision;
+    }
+
+    void setContinuous(bool newContinuous) {
+        continuousCollision = newContinuous;
+    }
+
+    uint32_t getCollisionLayer() const {
+        return collisionLayer;
+    }
+
+    uint32_t getCollisionMask() const {
+        return collisionMask;
+    }
+
+    // Two bodies only collide when each one's layer is in the other one's mask. The physics
+    // world drops other pairs in the broadphase, before any narrowphase work.
+    void setCollisionFilter(uint32_t newLayer, uint32_t newMask) {
+        collisionLayer = newLayer;
+        collisionMask = newMask;
+    }
+
+    // Box colliders are axis aligned by default. Oriented ones turn with the body rotation and
+    // the collider rotation and collide with separating axis tests.
+    void setOrientedBox(bool oriented) {
+        if (colliderType == ColliderType::BoundingBox || colliderType == ColliderType::OrientedBox) {
+            colliderType = oriented ? ColliderType::OrientedBox : ColliderType::BoundingBox;
+        }
+    }
+
+    // Collider rotation in radians applied around X, then Y, then Z, like getBoundingBoxMin/Max do
+    glm::quat getColliderOrientation() const {
+        return glm::angleAxis(colliderRotation.z, glm::vec3(0.0f, 0.0f, 1.0f)) *
+            glm::angleAxis(colliderRotation.y, glm::vec3(0.0f, 1.0f, 0.0f)) *
+            glm::angleAxis(colliderRotation.x, glm::vec3(1.0f, 0.0f, 0.0f));
+    }
+
+    // World space box of an oriented box collider
+    OrientedBox getOrientedBox() const {
+        return OrientedBox(transform.getPosition(), transform.getOrientation() * getColliderOrientation(), boundingBoxMin, boundingBoxMax);
+    }
+
+    // Unrotated collider bounds
+    glm::vec3 getLocalBoundingBoxMin() const {
+        return boundingBoxMin;
+    }
+
+    glm::vec3 getLocalBoundingBoxMax() const {
+        return boundingBoxMax;
+    }
+
     enum class ColliderType {
         BoundingBox,
-        Sphere
+        Sphere,
+        // Box that turns with the body, see setOrientedBox
+        OrientedBox,
+        // Static triangle mesh, only created through PhysicsWorld::addMeshCollider
+        Mesh
     } colliderType;
 
-    // Methods to get the bounding box dimensions
+    // Methods to get the bounding box dimensions, with the collider rotation applied
     glm::vec3 getBoundingBoxMin() const {
-        // Apply rotation to the min bounding box coordinates
-        glm::vec3 rotatedMin = boundingBoxMin;
-        rotatedMin = glm::rotateX(rotatedMin, colliderRotation.x);
-        rotatedMin = glm::rotateY(rotatedMin, colliderRotation.y);
-        rotatedMin = glm::rotateZ(rotatedMin, colliderRotation.z);
-        return rotatedMin;
+        return rotatedBoundingBoxMin;
     }
 
     glm::vec3 getBoundingBoxMax() const {
-        // Apply rotation to the max bounding box coordinates
-        glm::vec3 rotatedMax = boundingBoxMax;
-        rotatedMax = glm::rotateX(rotatedMax, colliderRotation.x);
-        rotatedMax = glm::rotateY(rotatedMax, colliderRotation.y);
-        rotatedMax = glm::rotateZ(rotatedMax, colliderRotation.z);
-        return rotatedMax;
+        return rotatedBoundingBoxMax;
+    }
+
+    // World space bounds of the collider, used by the broadphase
+    AABB getAABB() const {
+        glm::vec3 position = transform.getPosition();
+        if (colliderType == ColliderType::Sphere) {
+            return AABB(position - glm::vec3(radius), position + glm::vec3(radius));
+        }
+        if (colliderType == ColliderType::OrientedBox) {
+            return getOrientedBox().getAABB();
+        }
+
+        // The rotated corners are not ordered anymore, so sort them per axis
+        return AABB(position + glm::min(rotatedBoundingBoxMin, rotatedBoundingBoxMax),
+            position + glm::max(rotatedBoundingBoxMin, rotatedBoundingBoxMax));
     }
 
     // Bounding box collision detection
@@ -166,6 +278,7 @@ public:
         glm::vec3 maxB = other.getPosition() + other.getBoundingBoxMax();
 
         // Check if this bounding box intersects with the other bounding box
+        glm::vec3 position = transform.getPosition();
         return (position.x + boundingBoxMax.x >= minB.x &&
             position.x + boundingBoxMin.x <= maxB.x &&
             position.y + boundingBoxMax.y >= minB.y &&
@@ -173,6 +286,20 @@ public:
             position.z + boundingBoxMax.z >= minB.z &&
             position.z + boundingBoxMin.z <= maxB.z);
     }
+
+private:
+    // Applies the collider rotation to the min and max corners
+    void updateRotatedBoundingBox() {
+        rotatedBoundingBoxMin = boundingBoxMin;
+        rotatedBoundingBoxMin = glm::rotateX(rotatedBoundingBoxMin, colliderRotation.x);
+        rotatedBoundingBoxMin = glm::rotateY(rotatedBoundingBoxMin, colliderRotation.y);
+        rotatedBoundingBoxMin = glm::rotateZ(rotatedBoundingBoxMin, colliderRotation.z);
+
+        rotatedBoundingBoxMax = boundingBoxMax;
+        rotatedBoundingBoxMax = glm::rotateX(rotatedBoundingBoxMax, colliderRotation.x);
+        rotatedBoundingBoxMax = glm::rotateY(rotatedBoundingBoxMax, colliderRotation.y);
+        rotatedBoundingBoxMax = glm::rotateZ(rotatedBoundingBoxMax, colliderRotation.z);
+    }
 };
 
 #endif
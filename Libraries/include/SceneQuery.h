@@ -0,0 +1,213 @@
+#ifndef SCENE_QUERY_H
+#define SCENE_QUERY_H
+
+#include <glm/glm.hpp>
+#include <PhysicsSimd.h>
+#include <AABB.h>
+
+#include <vector>
+#include <cstdint>
+#include <cmath>
+
+// Ray from origin along the normalized direction
+struct RayQuery {
+    glm::vec3 origin;
+    glm::vec3 direction;
+    float maxDistance;
+};
+
+// Sphere swept from origin along the normalized direction
+struct SphereCastQuery {
+    glm::vec3 origin;
+    glm::vec3 direction;
+    float radius;
+    float maxDistance;
+};
+
+// Sphere volume, finds every body touching it
+struct OverlapQuery {
+    glm::vec3 center;
+    float radius;
+};
+
+// Shapes the broadphase returned for one query, packed one array per component and padded
+// to the SIMD width. Spheres and boxes are kept apart so each gets its own kernel.
+struct QueryCandidateBatch {
+    std::vector<float> sphereX, sphereY, sphereZ, sphereRadius;
+    std::vector<uint32_t> sphereBody;
+    std::vector<float> boxMinX, boxMinY, boxMinZ;
+    std::vector<float> boxMaxX, boxMaxY, boxMaxZ;
+    std::vector<uint32_t> boxBody;
+
+    void clear() {
+        sphereX.clear(); sphereY.clear(); sphereZ.clear(); sphereRadius.clear();
+        sphereBody.clear();
+        boxMinX.clear(); boxMinY.clear(); boxMinZ.clear();
+        boxMaxX.clear(); boxMaxY.clear(); boxMaxZ.clear();
+        boxBody.clear();
+    }
+
+    size_t sphereCount() const {
+        return sphereBody.size();
+    }
+
+    size_t boxCount() const {
+        return boxBody.size();
+    }
+
+    void addSphere(uint32_t body, const glm::vec3& center, float radius) {
+        sphereX.push_back(center.x); sphereY.push_back(center.y); sphereZ.push_back(center.z); sphereRadius.push_back(radius);
+        sphereBody.push_back(body);
+    }
+
+    void addBox(uint32_t body, const glm::vec3& boxMin, const glm::vec3& boxMax) {
+        boxMinX.push_back(boxMin.x); boxMinY.push_back(boxMin.y); boxMinZ.push_back(boxMin.z);
+        boxMaxX.push_back(boxMax.x); boxMaxY.push_back(boxMax.y); boxMaxZ.push_back(boxMax.z);
+        boxBody.push_back(body);
+    }
+
+    // Fills the last registers with shapes far away from any query
+    void pad() {
+        while (sphereX.size() % SimdFloat::width != 0) {
+            sphereX.push_back(1e18f); sphereY.push_back(0.0f); sphereZ.push_back(0.0f); sphereRadius.push_back(0.0f);
+        }
+        while (boxMinX.size() % SimdFloat::width != 0) {
+            boxMinX.push_back(1e18f); boxMinY.push_back(1e18f); boxMinZ.push_back(1e18f);
+            boxMaxX.push_back(1e18f); boxMaxY.push_back(1e18f); boxMaxZ.push_back(1e18f);
+        }
+    }
+};
+
+// Closest shape a ray hit in a candidate batch
+struct QueryHit {
+    uint32_t body;
+    bool sphere;
+    float distance;
+};
+
+// Batched leaf tests for scene queries. Each kernel tests SimdFloat::width shapes against
+// one query per iteration and only drops to scalar code for lanes that improve the result.
+class SceneQuery {
+public:
+    // Finds the closest shape hit by the ray within maxDistance. Every shape is grown by
+    // inflate, which turns the ray into a sphere cast.
+    static bool castRay(QueryCandidateBatch& batch, const glm::vec3& origin, const glm::vec3& direction, float maxDistance,
+        float inflate, QueryHit& hit) {
+        const int width = SimdFloat::width;
+        size_t sphereCount = batch.sphereCount();
+        size_t boxCount = batch.boxCount();
+        batch.pad();
+
+        float closest = maxDistance;
+        bool found = false;
+        float distance[width];
+
+        SimdFloat ox(origin.x), oy(origin.y), oz(origin.z);
+        SimdFloat dx(direction.x), dy(direction.y), dz(direction.z);
+        SimdFloat grow(inflate);
+        SimdFloat zero(0.0f);
+
+        for (size_t i = 0; i < sphereCount; i += width) {
+            SimdFloat tx = ox - SimdFloat::load(&batch.sphereX[i]);
+            SimdFloat ty = oy - SimdFloat::load(&batch.sphereY[i]);
+            SimdFloat tz = oz - SimdFloat::load(&batch.sphereZ[i]);
+            SimdFloat r = SimdFloat::load(&batch.sphereRadius[i]) + grow;
+
+            SimdFloat b = tx * dx + ty * dy + tz * dz;
+            SimdFloat c = tx * tx + ty * ty + tz * tz - r * r;
+            SimdFloat discriminant = b * b - c;
+            SimdFloat t = simdMax(zero - b - simdSqrt(simdMax(discriminant, zero)), zero);
+
+            // Misses when the ray starts outside and points away, or passes the sphere by
+            SimdFloat pointsAway = simdGreater(c, zero) & simdGreater(b, zero);
+            SimdFloat valid = simdLessEqual(zero, discriminant) & simdLessEqual(t, SimdFloat(closest));
+            int hits = simdMoveMask(valid) & ~simdMoveMask(pointsAway);
+            if (hits == 0) {
+                continue;
+            }
+
+            t.store(distance);
+            for (int lane = 0; lane < width; ++lane) {
+                if ((hits & (1 << lane)) && i + lane < sphereCount && distance[lane] <= closest) {
+                    closest = distance[lane];
+                    hit.body = batch.sphereBody[i + lane];
+                    hit.sphere = true;
+                    found = true;
+                }
+            }
+        }
+
+        // Slab test, with the same parallel axis guard as the tree traversals
+        glm::vec3 inverse = rayInverseDirection(direction);
+        SimdFloat ix(inverse.x), iy(inverse.y), iz(inverse.z);
+
+        for (size_t i = 0; i < boxCount; i += width) {
+            SimdFloat x1 = (SimdFloat::load(&batch.boxMinX[i]) - grow - ox) * ix;
+            SimdFloat x2 = (SimdFloat::load(&batch.boxMaxX[i]) + grow - ox) * ix;
+            SimdFloat y1 = (SimdFloat::load(&batch.boxMinY[i]) - grow - oy) * iy;
+            SimdFloat y2 = (SimdFloat::load(&batch.boxMaxY[i]) + grow - oy) * iy;
+            SimdFloat z1 = (SimdFloat::load(&batch.boxMinZ[i]) - grow - oz) * iz;
+            SimdFloat z2 = (SimdFloat::load(&batch.boxMaxZ[i]) + grow - oz) * iz;
+
+            SimdFloat enter = simdMax(simdMax(simdMin(x1, x2), simdMin(y1, y2)), simdMax(simdMin(z1, z2), zero));
+            SimdFloat exit = simdMin(simdMin(simdMax(x1, x2), simdMax(y1, y2)), simdMin(simdMax(z1, z2), SimdFloat(closest)));
+            int hits = simdMoveMask(simdLessEqual(enter, exit));
+            if (hits == 0) {
+                continue;
+            }
+
+            enter.store(distance);
+            for (int lane = 0; lane < width; ++lane) {
+                if ((hits & (1 << lane)) && i + lane < boxCount && distance[lane] <= closest) {
+                    closest = distance[lane];
+                    hit.body = batch.boxBody[i + lane];
+                    hit.sphere = false;
+                    found = true;
+                }
+            }
+        }
+
+        hit.distance = closest;
+        return found;
+    }
+
+    // Appends every shape touching the sphere volume to results
+    static void overlapSphere(QueryCandidateBatch& batch, const glm::vec3& center, float radius, std::vector<uint32_t>& results) {
+        const int width = SimdFloat::width;
+        size_t sphereCount = batch.sphereCount();
+        size_t boxCount = batch.boxCount();
+        batch.pad();
+
+        SimdFloat cx(center.x), cy(center.y), cz(center.z);
+        SimdFloat r(radius);
+
+        for (size_t i = 0; i < sphereCount; i += width) {
+            SimdFloat dx = SimdFloat::load(&batch.sphereX[i]) - cx;
+            SimdFloat dy = SimdFloat::load(&batch.sphereY[i]) - cy;
+            SimdFloat dz = SimdFloat::load(&batch.sphereZ[i]) - cz;
+            SimdFloat reach = SimdFloat::load(&batch.sphereRadius[i]) + r;
+            int hits = simdMoveMask(simdLessEqual(dx * dx + dy * dy + dz * dz, reach * reach));
+            appendLanes(hits, i, sphereCount, batch.sphereBody, results);
+        }
+
+        for (size_t i = 0; i < boxCount; i += width) {
+            // Distance from the center to the closest point on the box
+            SimdFloat dx = cx - simdMin(simdMax(cx, SimdFloat::load(&batch.boxMinX[i])), SimdFloat::load(&batch.boxMaxX[i]));
+            SimdFloat dy = cy - simdMin(simdMax(cy, SimdFloat::load(&batch.boxMinY[i])), SimdFloat::load(&batch.boxMaxY[i]));
+            SimdFloat dz = cz - simdMin(simdMax(cz, SimdFloat::load(&batch.boxMinZ[i])), SimdFloat::load(&batch.boxMaxZ[i]));
+            int hits = simdMoveMask(simdLessEqual(dx * dx + dy * dy + dz * dz, r * r));
+            appendLanes(hits, i, boxCount, batch.boxBody, results);
+        }
+    }
+
+private:
+    static void appendLanes(int hits, size_t first, size_t count, const std::vector<uint32_t>& bodies, std::vector<uint32_t>& results) {
+        for (int lane = 0; hits != 0 && lane < SimdFloat::width; ++lane) {
+            if ((hits & (1 << lane)) && first + lane < count) {
+                results.push_back(bodies[first + lane]);
+            }
+        }
+    }
+};
+
+#endif
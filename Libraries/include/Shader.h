@@ -8,6 +8,11 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <vector>
+#include <unordered_map>
+
+// Number of a uniform name, the same in every program, see Shader::GetUniformID
+typedef unsigned int UniformID;
 
 class Shader
 {
@@ -89,6 +94,7 @@ public:
             glAttachShader(ID, geometry);
         glLinkProgram(ID);
         checkCompileErrors(ID, "PROGRAM");
+        reflectUniforms();
         // delete the shaders as they're linked into our program now and no longer necessary
         glDeleteShader(vertex);
         glDeleteShader(fragment);
@@ -106,72 +112,230 @@ public:
     {
         glDeleteProgram(ID);
     }
+    // uniform names are numbered once for all programs, every program keeps the locations
+    // of its active uniforms in a table indexed by that number. Setting a uniform by ID is
+    // an array lookup instead of a glGetUniformLocation call, set by name still hashes the
+    // name. IDs are handed out on the render thread only.
+    // ------------------------------------------------------------------------
+    static UniformID GetUniformID(const std::string& name)
+    {
+        std::unordered_map<std::string, UniformID>& ids = uniformIDs();
+        auto found = ids.find(name);
+        if (found != ids.end())
+            return found->second;
+        UniformID id = (UniformID)ids.size();
+        ids.emplace(name, id);
+        return id;
+    }
+    // binding point of a uniform block, every program declaring a block of that name reads
+    // it from the same binding, see UniformBufferRing
+    // ------------------------------------------------------------------------
+    static GLuint GetBlockBinding(const std::string& blockName)
+    {
+        std::unordered_map<std::string, GLuint>& bindings = blockBindings();
+        auto found = bindings.find(blockName);
+        if (found != bindings.end())
+            return found->second;
+        GLuint binding = (GLuint)bindings.size();
+        bindings.emplace(blockName, binding);
+        return binding;
+    }
+    // -1 for uniforms the program doesn't use, which glUniform calls ignore
+    // ------------------------------------------------------------------------
+    GLint getLocation(UniformID id) const
+    {
+        return id < uniformLocations.size() ? uniformLocations[id] : -1;
+    }
     // utility uniform functions
     // ------------------------------------------------------------------------
     void setBool(const std::string& name, bool value) const
     {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+        setBool(GetUniformID(name), value);
+    }
+    void setBool(UniformID id, bool value) const
+    {
+        glUniform1i(getLocation(id), (int)value);
     }
     // ------------------------------------------------------------------------
     void setInt(const std::string& name, int value) const
     {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+        setInt(GetUniformID(name), value);
+    }
+    void setInt(UniformID id, int value) const
+    {
+        glUniform1i(getLocation(id), value);
     }
     // ------------------------------------------------------------------------
     void setFloat(const std::string& name, float value) const
     {
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+        setFloat(GetUniformID(name), value);
+    }
+    void setFloat(UniformID id, float value) const
+    {
+        glUniform1f(getLocation(id), value);
     }
     // ------------------------------------------------------------------------
     void setVec2(const std::string& name, const glm::vec2& value) const
     {
-        glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        setVec2(GetUniformID(name), value);
+    }
+    void setVec2(UniformID id, const glm::vec2& value) const
+    {
+        glUniform2fv(getLocation(id), 1, &value[0]);
     }
     void setVec2(const std::string& name, float x, float y) const
     {
-        glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y);
+        setVec2(GetUniformID(name), x, y);
+    }
+    void setVec2(UniformID id, float x, float y) const
+    {
+        glUniform2f(getLocation(id), x, y);
     }
     // ------------------------------------------------------------------------
     void setVec3(const std::string& name, const glm::vec3& value) const
     {
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        setVec3(GetUniformID(name), value);
+    }
+    void setVec3(UniformID id, const glm::vec3& value) const
+    {
+        glUniform3fv(getLocation(id), 1, &value[0]);
     }
     void setVec3(const std::string& name, float x, float y, float z) const
     {
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z);
+        setVec3(GetUniformID(name), x, y, z);
+    }
+    void setVec3(UniformID id, float x, float y, float z) const
+    {
+        glUniform3f(getLocation(id), x, y, z);
     }
     // ------------------------------------------------------------------------
     void setVec4(const std::string& name, const glm::vec4& value) const
     {
-        glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        setVec4(GetUniformID(name), value);
+    }
+    void setVec4(UniformID id, const glm::vec4& value) const
+    {
+        glUniform4fv(getLocation(id), 1, &value[0]);
     }
-    void setVec4(const std::string& name, float x, float y, float z, float w)
+    void setVec4(const std::string& name, float x, float y, float z, float w) const
     {
-        glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w);
+        setVec4(GetUniformID(name), x, y, z, w);
+    }
+    void setVec4(UniformID id, float x, float y, float z, float w) const
+    {
+        glUniform4f(getLocation(id), x, y, z, w);
     }
     // ------------------------------------------------------------------------
     void setMat2(const std::string& name, const glm::mat2& mat) const
     {
-        glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        setMat2(GetUniformID(name), mat);
+    }
+    void setMat2(UniformID id, const glm::mat2& mat) const
+    {
+        glUniformMatrix2fv(getLocation(id), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
     void setMat3(const std::string& name, const glm::mat3& mat) const
     {
-        glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        setMat3(GetUniformID(name), mat);
+    }
+    void setMat3(UniformID id, const glm::mat3& mat) const
+    {
+        glUniformMatrix3fv(getLocation(id), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
     void setMat4(const std::string& name, const glm::mat4& mat) const
     {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        setMat4(GetUniformID(name), mat);
+    }
+    void setMat4(UniformID id, const glm::mat4& mat) const
+    {
+        glUniformMatrix4fv(getLocation(id), 1, GL_FALSE, &mat[0][0]);
+    }
+    // whole array at once, id is the one of the bare array name
+    // ------------------------------------------------------------------------
+    void setMat4Array(UniformID id, const glm::mat4* mats, GLsizei count) const
+    {
+        glUniformMatrix4fv(getLocation(id), count, GL_FALSE, &mats[0][0][0]);
     }
     void setTexture2D(const std::string& name, GLuint textureID, GLenum textureUnit) const
+    {
+        setTexture2D(GetUniformID(name), textureID, textureUnit);
+    }
+    void setTexture2D(UniformID id, GLuint textureID, GLenum textureUnit) const
     {
         glActiveTexture(GL_TEXTURE0 + textureUnit); // Activate texture unit
         glBindTexture(GL_TEXTURE_2D, textureID);    // Bind the texture to the specified unit
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), textureUnit); // Set the sampler to use the texture unit
+        glUniform1i(getLocation(id), textureUnit); // Set the sampler to use the texture unit
     }
 
 private:
+    // location of every uniform ID, -1 where the program has no such uniform
+    std::vector<GLint> uniformLocations;
+
+    static std::unordered_map<std::string, UniformID>& uniformIDs()
+    {
+        static std::unordered_map<std::string, UniformID> ids;
+        return ids;
+    }
+    static std::unordered_map<std::string, GLuint>& blockBindings()
+    {
+        static std::unordered_map<std::string, GLuint> bindings;
+        return bindings;
+    }
+
+    void setLocation(UniformID id, GLint location)
+    {
+        if (id >= uniformLocations.size())
+            uniformLocations.resize(id + 1, -1);
+        uniformLocations[id] = location;
+    }
+    // fills the location table from the active uniforms of the linked program and points
+    // its uniform blocks at their shared binding points
+    // ------------------------------------------------------------------------
+    void reflectUniforms()
+    {
+        GLint uniformCount = 0;
+        GLint maxNameLength = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &uniformCount);
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+        std::vector<GLchar> nameBuffer(maxNameLength + 1);
+        for (GLint i = 0; i < uniformCount; i++)
+        {
+            GLint size;
+            GLenum type;
+            GLsizei length;
+            glGetActiveUniform(ID, (GLuint)i, (GLsizei)nameBuffer.size(), &length, &size, &type, nameBuffer.data());
+            std::string name(nameBuffer.data(), length);
+            GLint location = glGetUniformLocation(ID, name.c_str());
+            // members of uniform blocks have no location
+            if (location < 0)
+                continue;
+            // arrays are listed once as "name[0]", register the bare name and every element
+            if (name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0)
+            {
+                std::string arrayName = name.substr(0, name.size() - 3);
+                setLocation(GetUniformID(arrayName), location);
+                for (GLint element = 0; element < size; element++)
+                {
+                    std::string elementName = arrayName + "[" + std::to_string(element) + "]";
+                    setLocation(GetUniformID(elementName), glGetUniformLocation(ID, elementName.c_str()));
+                }
+            }
+            else
+                setLocation(GetUniformID(name), location);
+        }
+
+        GLint blockCount = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_BLOCKS, &blockCount);
+        for (GLint i = 0; i < blockCount; i++)
+        {
+            GLchar blockName[256];
+            GLsizei length;
+            glGetActiveUniformBlockName(ID, (GLuint)i, sizeof(blockName), &length, blockName);
+            glUniformBlockBinding(ID, (GLuint)i, GetBlockBinding(std::string(blockName, length)));
+        }
+    }
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
     void checkCompileErrors(GLuint shader, std::string type)
@@ -10,6 +10,7 @@
 #include <vector>
 #include <Shader.h>
 #include <model.h>
+#include <RenderQueue.h>
 
 class ShadowMapping {
 public:
@@ -35,45 +36,59 @@ public:
         glDrawBuffer(GL_NONE);
         glReadBuffer(GL_NONE);
         glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+        shadowMatricesUniform = Shader::GetUniformID("shadowMatrices");
+        modelUniform = Shader::GetUniformID("model");
     }
 
+    // The depth shader reads the light position and far plane from the FrameData block, they
+    // have to be the ones written there for this frame
     void CreateDepthCubemap(glm::vec3 lightPos, float nearPlane, float farPlane)
     {
         near_plane = nearPlane;
         far_plane = farPlane;
 
         shadowProj = glm::perspective(glm::radians(90.0f), (float)SHADOW_WIDTH / (float)SHADOW_HEIGHT, near_plane, far_plane);
+        // Called every frame, keep the storage but not last frame's matrices
+        shadowTransforms.clear();
         shadowTransforms.push_back(shadowProj * glm::lookAt(lightPos, lightPos + glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f)));
         shadowTransforms.push_back(shadowProj * glm::lookAt(lightPos, lightPos + glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f)));
         shadowTransforms.push_back(shadowProj * glm::lookAt(lightPos, lightPos + glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f)));
         shadowTransforms.push_back(shadowProj * glm::lookAt(lightPos, lightPos + glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, 0.0f, -1.0f)));
         shadowTransforms.push_back(shadowProj * glm::lookAt(lightPos, lightPos + glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, -1.0f, 0.0f)));
         shadowTransforms.push_back(shadowProj * glm::lookAt(lightPos, lightPos + glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, -1.0f, 0.0f)));
-    
-        lightPosition = lightPos;
     }
 
-    void RenderDepthCubemap(Shader simpleDepthShader, std::vector<std::pair<Model, glm::mat4>> models)
+    void RenderDepthCubemap(Shader& simpleDepthShader, const std::vector<std::pair<Model*, glm::mat4>>& models)
     {
-        glViewport(0, 0, SHADOW_WIDTH, SHADOW_HEIGHT);
-        glBindFramebuffer(GL_FRAMEBUFFER, depthMapFBO);
-        glClear(GL_DEPTH_BUFFER_BIT);
-        simpleDepthShader.use();
-
-        for (unsigned int i = 0; i < 6; ++i)
-            simpleDepthShader.setMat4("shadowMatrices[" + std::to_string(i) + "]", shadowTransforms[i]);
-        simpleDepthShader.setFloat("far_plane", far_plane);
-        simpleDepthShader.setVec3("lightPos", lightPosition);
+        BeginDepthPass(simpleDepthShader);
 
         for (auto& modelData : models) {
-            simpleDepthShader.setMat4("model", modelData.second);
-            modelData.first.Draw(simpleDepthShader);
+            simpleDepthShader.setMat4(modelUniform, modelData.second);
+            modelData.first->Draw(simpleDepthShader);
         }
 
         glBindFramebuffer(GL_FRAMEBUFFER, 0); // Unbind the framebuffer after rendering
     }
 
+    // Draws the shadow casters of a frame's render queue
+    void RenderDepthCubemap(Shader& simpleDepthShader, RenderQueue& queue)
+    {
+        BeginDepthPass(simpleDepthShader);
+        queue.DrawShadowCasters(simpleDepthShader);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0); // Unbind the framebuffer after rendering
+    }
+
 private:
+    void BeginDepthPass(Shader& simpleDepthShader)
+    {
+        glViewport(0, 0, SHADOW_WIDTH, SHADOW_HEIGHT);
+        glBindFramebuffer(GL_FRAMEBUFFER, depthMapFBO);
+        glClear(GL_DEPTH_BUFFER_BIT);
+        simpleDepthShader.use();
+        simpleDepthShader.setMat4Array(shadowMatricesUniform, shadowTransforms.data(), (GLsizei)shadowTransforms.size());
+    }
+
     unsigned int depthMapFBO;
     unsigned int depthCubemap;
     unsigned int SHADOW_WIDTH;
@@ -82,7 +97,8 @@ private:
     float far_plane = 0.0f;
     glm::mat4 shadowProj;
     std::vector<glm::mat4> shadowTransforms;
-    glm::vec3 lightPosition;
+    UniformID shadowMatricesUniform;
+    UniformID modelUniform;
 };
 
 #endif // SHADOW_MAPPING_H
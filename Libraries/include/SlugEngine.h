@@ -8,27 +8,59 @@
 #include <glm/gtx/quaternion.hpp>
 #include <glm/gtx/extended_min_max.hpp>
 #include <Rigidbody.h>
+#include <PhysicsWorld.h>
+#include <PhysicsThread.h>
 #include <stb_image.h>
 #include <model.h>
 #include <Shader.h>
 #include <ShadowConfiguration.h>
-
-glm::mat4 makeModel(Rigidbody& rigidbody, glm::vec3 scale)
+#include <RenderQueue.h>
+#include <UniformBuffer.h>
+
+#include <cstddef>
+
+// std140 mirror of the FrameData block in the shaders. vec3 members are aligned to 16 bytes
+// there, a float after one fills the rest of its slot.
+struct FrameUniforms {
+    glm::mat4 projection;
+    glm::mat4 view;
+    glm::vec3 lightPos;
+    float padding;
+    glm::vec3 viewPos;
+    float farPlane;
+};
+static_assert(offsetof(FrameUniforms, lightPos) == 128 && offsetof(FrameUniforms, viewPos) == 144 &&
+    offsetof(FrameUniforms, farPlane) == 156 && sizeof(FrameUniforms) == 160, "FrameUniforms doesn't match the std140 layout of FrameData");
+
+glm::mat4 makeModel(glm::vec3 position, glm::vec3 rotation, glm::vec3 scale)
 {
-    glm::mat4 model = glm::mat4(1.0f);
+    // Same rotation order as before, built from a quaternion instead of three rotate calls
+    return Transform(position, rotation, scale).getMatrix();
+}
 
-    // Translate to the rigidbody's position
-    model = glm::translate(model, rigidbody.getPosition());
+// Reuses the cached matrix as long as the transform didn't change
+glm::mat4 makeModel(Transform& transform, glm::vec3 scale)
+{
+    transform.setScale(scale);
+    return transform.getMatrix();
+}
 
-    // Apply rotations around the x, y, and z axes
-    model = glm::rotate(model, glm::radians(rigidbody.getRotation().x), glm::vec3(0, 0, 1));
-    model = glm::rotate(model, glm::radians(rigidbody.getRotation().y), glm::vec3(0, 1, 0));
-    model = glm::rotate(model, glm::radians(rigidbody.getRotation().z), glm::vec3(1, 0, 0));
+glm::mat4 makeModel(Rigidbody& rigidbody, glm::vec3 scale)
+{
+    return makeModel(rigidbody.getTransform(), scale);
+}
 
-    // Apply scaling
-    model = glm::scale(model, scale);
+// Uses the transform interpolated between the last two fixed physics steps
+glm::mat4 makeModel(PhysicsWorld& world, BodyHandle body, glm::vec3 scale)
+{
+    return makeModel(world.getInterpolatedTransform(body), scale);
+}
 
-    return model;
+// Uses a snapshot published by the PhysicsThread, alpha comes from getInterpolationAlpha.
+// The thread keeps the transform, so resting bodies reuse their matrix.
+glm::mat4 makeModel(PhysicsThread& physics, const PhysicsSnapshot& snapshot, BodyHandle body, float alpha, glm::vec3 scale)
+{
+    return makeModel(physics.getInterpolatedTransform(snapshot, body, alpha), scale);
 }
 
 bool GetKeyDown(GLFWwindow* window, int key) {
@@ -144,9 +176,11 @@ void Render2D(Shader& shader, unsigned int& texture, float x, float y, float sca
     shader.setMat4("transform", transform);
     shader.setTexture2D("texture1", texture, 0);
 
-    // render container
+    // render container, sprites keep their transparent edges
+    glEnable(GL_BLEND);
     glBindTexture(GL_TEXTURE_2D, texture);
     glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+    glDisable(GL_BLEND);
 
     glBindVertexArray(0);
 }
@@ -170,10 +204,12 @@ float calculatePenetrationDepth(const Rigidbody& rb1, const Rigidbody& rb2) {
     return minPenetrationDepth;
 }
 
-void renderObject(Model OurModel, glm::mat4 model, Shader DefaultShader, unsigned int path)
+void renderObject(Model& OurModel, const glm::mat4& model, Shader& DefaultShader, unsigned int path)
 {
-    DefaultShader.setMat4("model", model);
-    DefaultShader.setTexture2D("diffuseTexture", path, 0);
+    static const UniformID modelUniform = Shader::GetUniformID("model");
+    static const UniformID diffuseTextureUniform = Shader::GetUniformID("diffuseTexture");
+    DefaultShader.setMat4(modelUniform, model);
+    DefaultShader.setTexture2D(diffuseTextureUniform, path, 0);
     OurModel.Draw(DefaultShader);
 }
 
@@ -302,102 +338,3 @@ void ResolveCollisionIgnoreFirst(Rigidbody& boxRigidbody, Rigidbody& rigidbody)
         rigidbody.setRotation(rigidbody.getRotation() + angularVelocityChangeA);
     }
 }
-
-void ResolveSphereCollision(Rigidbody& sphere1, Rigidbody& sphere2, float deltaTime) {
-
-    glm::vec3 pos1 = sphere1.getPosition();
-    glm::vec3 pos2 = sphere2.getPosition();
-    float radius1 = sphere1.getRadius();
-    float radius2 = sphere2.getRadius();
-
-    glm::vec3 collisionNormal = pos2 - pos1;
-    float distance = glm::length(collisionNormal);
-    float combinedRadii = radius1 + radius2;
-
-    // Check for collision
-    if (distance < combinedRadii) {
-        // Normalize the collision normal
-        collisionNormal = glm::normalize(collisionNormal);
-
-        // Calculate relative velocity
-        glm::vec3 relativeVelocity = sphere1.getVelocity() - sphere2.getVelocity();
-        float relativeVelocityNormal = glm::dot(relativeVelocity, collisionNormal);
-
-        // Calculate restitution (bounciness)
-        float restitution = 0.5f;
-
-        // Calculate impulse scalar
-        float j = -(1 + restitution) * relativeVelocityNormal;
-        j /= (1 / sphere1.getMass()) + (1 / sphere2.getMass());
-
-        // Calculate impulse vector
-        glm::vec3 impulse = j * collisionNormal;
-
-        // Apply impulse to the velocities
-        sphere1.setVelocity(sphere1.getVelocity() + impulse / sphere1.getMass());
-        sphere2.setVelocity(sphere2.getVelocity() - impulse / sphere2.getMass());
-
-        // Position correction
-        float penetrationDepth = combinedRadii - distance;
-        glm::vec3 correction = (penetrationDepth / ((1 / sphere1.getMass()) + (1 / sphere2.getMass()))) * collisionNormal;
-
-        sphere1.setPosition(pos1 - correction * (1 / sphere1.getMass()));
-        sphere2.setPosition(pos2 + correction * (1 / sphere2.getMass()));
-
-        glm::vec3 contactPoint = pos1 + collisionNormal * radius1;
-        glm::vec3 r1 = contactPoint - pos1;
-        glm::vec3 r2 = contactPoint - pos2;
-
-        glm::vec3 angularChange1 = r1 / sphere1.getMass();
-        glm::vec3 angularChange2 = r2 / sphere2.getMass();
-
-        
-        // Apply torque to rotation
-        sphere2.setAngularVelocity(sphere2.getAngularVelocity() + r2 * 0.5f);
-        sphere1.setAngularVelocity(sphere1.getAngularVelocity() + r1 * 0.5f);
-    }
-}
-
-
-void ResolveSphereVsBoundingBoxCollision(Rigidbody& sphere, Rigidbody& box) {
-    glm::vec3 spherePos = sphere.getPosition();
-    glm::vec3 boxMin = box.getBoundingBoxMin() + box.getPosition();
-    glm::vec3 boxMax = box.getBoundingBoxMax() + box.getPosition();
-
-    glm::vec3 closestPoint = glm::clamp(spherePos, boxMin, boxMax);
-    float distance = glm::distance(spherePos, closestPoint);
-
-    if (distance < sphere.getRadius()) {
-        glm::vec3 collisionNormal = glm::normalize(spherePos - closestPoint);
-        glm::vec3 relativeVelocity = sphere.getVelocity() - box.getVelocity();
-        float relativeVelocityNormal = glm::dot(relativeVelocity, collisionNormal);
-
-        float restitution = 0.1f;
-
-        float j = -(1 + restitution) * relativeVelocityNormal;
-        j /= 1 / sphere.getMass() + 1 / box.getMass();
-
-        glm::vec3 impulse = j * collisionNormal;
-
-        sphere.setVelocity(sphere.getVelocity() + impulse / sphere.getMass());
-
-        float penetrationDepth = sphere.getRadius() - distance;
-        glm::vec3 correction = penetrationDepth * collisionNormal;
-        sphere.setPosition(sphere.getPosition() + correction * (box.getMass() / (sphere.getMass() + box.getMass())));
-
-        // Calculate friction impulse
-        glm::vec3 tangent = relativeVelocity - relativeVelocityNormal * collisionNormal;
-        if (glm::length(tangent) > 0.0001f) {
-            tangent = glm::normalize(tangent);
-        }
-
-        float relativeVelocityTangent = glm::dot(relativeVelocity, tangent);
-        float frictionCoefficient = 0.05f; // This can be adjusted based on material properties
-        float jt = -relativeVelocityTangent;
-        jt /= 1 / sphere.getMass() + 1 / box.getMass();
-        jt = glm::clamp(jt, -j * frictionCoefficient, j * frictionCoefficient);
-
-        glm::vec3 frictionImpulse = jt * tangent;
-        sphere.setVelocity(sphere.getVelocity() + frictionImpulse / sphere.getMass());
-    }
-}
@@ -0,0 +1,194 @@
+#ifndef SPATIAL_HASH_GRID_H
+#define SPATIAL_HASH_GRID_H
+
+#include <glm/glm.hpp>
+#include <AABB.h>
+
+#include <vector>
+#include <cstdint>
+#include <cmath>
+#include <utility>
+
+// Uniform grid broadphase. Every body is binned into the cells its AABB touches and
+// only bodies sharing a cell are reported as candidate pairs. The grid is rebuilt from
+// scratch every step with a counting sort, so the cost is linear in the number of bodies.
+class SpatialHashGrid {
+public:
+    SpatialHashGrid(float initialCellSize = 2.0f, int initialMaxCellsPerBody = 64)
+        : cellSize(initialCellSize), inverseCellSize(1.0f / initialCellSize),
+        maxCellsPerBody(initialMaxCellsPerBody) {}
+
+    void setCellSize(float newCellSize) {
+        cellSize = newCellSize;
+        inverseCellSize = 1.0f / newCellSize;
+    }
+
+    float getCellSize() const {
+        return cellSize;
+    }
+
+    // Bodies covering more cells than this are kept in a separate list and tested
+    // against everything, so a huge ground box doesn't flood the grid
+    void setMaxCellsPerBody(int newMaxCellsPerBody) {
+        maxCellsPerBody = newMaxCellsPerBody;
+    }
+
+    void clear() {
+        entries.clear();
+        bounds.clear();
+        layers.clear();
+        masks.clear();
+        largeFlags.clear();
+        largeBodies.clear();
+    }
+
+    // Ids are expected to be dense, in the range [0, number of inserted bodies). Two bodies
+    // only pair up when each one's layer bits are in the other one's mask.
+    void insert(uint32_t id, const AABB& box, uint32_t layer = 0xFFFFFFFFu, uint32_t mask = 0xFFFFFFFFu) {
+        if (id >= bounds.size()) {
+            bounds.resize(id + 1);
+            layers.resize(id + 1, 0xFFFFFFFFu);
+            masks.resize(id + 1, 0xFFFFFFFFu);
+            largeFlags.resize(id + 1, 0);
+        }
+        bounds[id] = box;
+        layers[id] = layer;
+        masks[id] = mask;
+
+        glm::ivec3 minCell = getCell(box.min);
+        glm::ivec3 maxCell = getCell(box.max);
+        glm::ivec3 cellCount = maxCell - minCell + glm::ivec3(1);
+
+        // In 64 bits, the cell count of a large level box doesn't fit in an int
+        int64_t totalCells = (int64_t)cellCount.x * cellCount.y * cellCount.z;
+        if (totalCells > maxCellsPerBody) {
+            largeFlags[id] = 1;
+            largeBodies.push_back(id);
+            return;
+        }
+
+        for (int x = minCell.x; x <= maxCell.x; ++x) {
+            for (int y = minCell.y; y <= maxCell.y; ++y) {
+                for (int z = minCell.z; z <= maxCell.z; ++z) {
+                    entries.push_back({ x, y, z, id });
+                }
+            }
+        }
+    }
+
+    // Fills pairs with every overlapping pair of inserted bodies, each pair reported once
+    void computePairs(std::vector<std::pair<uint32_t, uint32_t>>& pairs) {
+        pairs.clear();
+        sortEntries();
+
+        for (size_t bucket = 0; bucket + 1 < bucketStarts.size(); ++bucket) {
+            uint32_t begin = bucketStarts[bucket];
+            uint32_t end = bucketStarts[bucket + 1];
+
+            for (uint32_t i = begin; i < end; ++i) {
+                const CellEntry& a = sortedEntries[i];
+                for (uint32_t j = i + 1; j < end; ++j) {
+                    const CellEntry& b = sortedEntries[j];
+
+                    // Different cells can land in the same bucket
+                    if (a.x != b.x || a.y != b.y || a.z != b.z || a.id == b.id || !canCollide(a.id, b.id)) {
+                        continue;
+                    }
+
+                    const AABB& boxA = bounds[a.id];
+                    const AABB& boxB = bounds[b.id];
+                    if (!boxA.overlaps(boxB)) {
+                        continue;
+                    }
+
+                    // Two bodies can share several cells, only the cell holding the
+                    // minimum corner of their overlap reports the pair
+                    glm::ivec3 ownerCell = getCell(glm::max(boxA.min, boxB.min));
+                    if (ownerCell.x != a.x || ownerCell.y != a.y || ownerCell.z != a.z) {
+                        continue;
+                    }
+
+                    pairs.push_back(makePair(a.id, b.id));
+                }
+            }
+        }
+
+        // Large bodies are tested against every other body
+        for (size_t i = 0; i < largeBodies.size(); ++i) {
+            uint32_t large = largeBodies[i];
+            for (uint32_t other = 0; other < bounds.size(); ++other) {
+                if (other == large || (largeFlags[other] && other < large) || !canCollide(large, other)) {
+                    continue;
+                }
+                if (bounds[large].overlaps(bounds[other])) {
+                    pairs.push_back(makePair(large, other));
+                }
+            }
+        }
+    }
+
+private:
+    struct CellEntry {
+        int x, y, z;
+        uint32_t id;
+    };
+
+    float cellSize;
+    float inverseCellSize;
+    int maxCellsPerBody;
+
+    std::vector<CellEntry> entries;
+    std::vector<CellEntry> sortedEntries;
+    std::vector<uint32_t> bucketStarts;
+    std::vector<uint32_t> bucketCursor;
+    std::vector<AABB> bounds;
+    std::vector<uint32_t> layers;
+    std::vector<uint32_t> masks;
+    std::vector<char> largeFlags;
+    std::vector<uint32_t> largeBodies;
+
+    bool canCollide(uint32_t a, uint32_t b) const {
+        return (layers[a] & masks[b]) != 0 && (layers[b] & masks[a]) != 0;
+    }
+
+    glm::ivec3 getCell(const glm::vec3& point) const {
+        return glm::ivec3(
+            (int)std::floor(point.x * inverseCellSize),
+            (int)std::floor(point.y * inverseCellSize),
+            (int)std::floor(point.z * inverseCellSize));
+    }
+
+    static uint32_t hashCell(int x, int y, int z) {
+        return ((uint32_t)x * 73856093u) ^ ((uint32_t)y * 19349663u) ^ ((uint32_t)z * 83492791u);
+    }
+
+    static std::pair<uint32_t, uint32_t> makePair(uint32_t a, uint32_t b) {
+        return a < b ? std::make_pair(a, b) : std::make_pair(b, a);
+    }
+
+    // Counting sort of the cell entries into hash buckets
+    void sortEntries() {
+        uint32_t bucketCount = 1;
+        while (bucketCount < entries.size() * 2) {
+            bucketCount <<= 1;
+        }
+        uint32_t mask = bucketCount - 1;
+
+        bucketStarts.assign(bucketCount + 1, 0);
+        for (size_t i = 0; i < entries.size(); ++i) {
+            bucketStarts[(hashCell(entries[i].x, entries[i].y, entries[i].z) & mask) + 1]++;
+        }
+        for (uint32_t i = 0; i < bucketCount; ++i) {
+            bucketStarts[i + 1] += bucketStarts[i];
+        }
+
+        sortedEntries.resize(entries.size());
+        bucketCursor.assign(bucketStarts.begin(), bucketStarts.end() - 1);
+        for (size_t i = 0; i < entries.size(); ++i) {
+            uint32_t bucket = hashCell(entries[i].x, entries[i].y, entries[i].z) & mask;
+            sortedEntries[bucketCursor[bucket]++] = entries[i];
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,91 @@
+#ifndef TRANSFORM_H
+#define TRANSFORM_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <cmath>
+
+// Position, orientation and scale of an object. Orientation is kept as a quaternion next to
+// the Euler angles it was set from, the world matrix is only rebuilt after one of them
+// actually changed.
+class Transform {
+public:
+    Transform(glm::vec3 initialPosition = glm::vec3(0.0f), glm::vec3 initialRotation = glm::vec3(0.0f),
+        glm::vec3 initialScale = glm::vec3(1.0f))
+        : position(initialPosition), rotation(initialRotation), scale(initialScale),
+        orientation(eulerToQuaternion(initialRotation)), matrixDirty(true) {}
+
+    // Euler angles in degrees, x turns around Z, y around Y and z around X, applied in that
+    // order like the glm::rotate calls makeModel used to do
+    static glm::quat eulerToQuaternion(const glm::vec3& degrees) {
+        glm::vec3 half = glm::radians(degrees) * 0.5f;
+        glm::quat aroundZ(std::cos(half.x), 0.0f, 0.0f, std::sin(half.x));
+        glm::quat aroundY(std::cos(half.y), 0.0f, std::sin(half.y), 0.0f);
+        glm::quat aroundX(std::cos(half.z), std::sin(half.z), 0.0f, 0.0f);
+        return aroundZ * aroundY * aroundX;
+    }
+
+    const glm::vec3& getPosition() const {
+        return position;
+    }
+
+    void setPosition(const glm::vec3& newPosition) {
+        if (newPosition != position) {
+            position = newPosition;
+            matrixDirty = true;
+        }
+    }
+
+    const glm::vec3& getRotation() const {
+        return rotation;
+    }
+
+    void setRotation(const glm::vec3& newRotation) {
+        if (newRotation != rotation) {
+            rotation = newRotation;
+            orientation = eulerToQuaternion(newRotation);
+            matrixDirty = true;
+        }
+    }
+
+    const glm::quat& getOrientation() const {
+        return orientation;
+    }
+
+    const glm::vec3& getScale() const {
+        return scale;
+    }
+
+    void setScale(const glm::vec3& newScale) {
+        if (newScale != scale) {
+            scale = newScale;
+            matrixDirty = true;
+        }
+    }
+
+    // translate * rotate * scale
+    const glm::mat4& getMatrix() const {
+        if (matrixDirty) {
+            glm::mat3 basis = glm::mat3_cast(orientation);
+            matrix = glm::mat4(
+                glm::vec4(basis[0] * scale.x, 0.0f),
+                glm::vec4(basis[1] * scale.y, 0.0f),
+                glm::vec4(basis[2] * scale.z, 0.0f),
+                glm::vec4(position, 1.0f));
+            matrixDirty = false;
+        }
+        return matrix;
+    }
+
+private:
+    glm::vec3 position;
+    glm::vec3 rotation;
+    glm::vec3 scale;
+    glm::quat orientation;
+
+    mutable glm::mat4 matrix;
+    mutable bool matrixDirty;
+};
+
+#endif
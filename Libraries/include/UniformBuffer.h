@@ -0,0 +1,86 @@
+#ifndef UNIFORM_BUFFER_H
+#define UNIFORM_BUFFER_H
+
+#include <glad/glad.h>
+#include <Shader.h>
+
+#include <string>
+#include <vector>
+#include <cstring>
+
+// Uniform block written once per frame and read by every program that declares a block of
+// the same name. Block has to match the std140 layout of the GLSL block.
+//
+// The slots of one buffer are used in turn, so a frame writes its slot while the GPU may
+// still read the ones of earlier frames. Each slot is fenced once the frame that read it
+// has been submitted, and only waited on when the ring comes around to it again, which
+// keeps the unsynchronized write safe without stalling on the frame just issued.
+template <typename Block>
+class UniformBufferRing
+{
+public:
+    UniformBufferRing(const std::string& blockName, unsigned int slotCount = 3)
+        : binding(Shader::GetBlockBinding(blockName)), fences(slotCount, nullptr), current(0), written(false)
+    {
+        GLint alignment = 1;
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        stride = (GLsizeiptr)((sizeof(Block) + alignment - 1) / alignment * alignment);
+
+        glGenBuffers(1, &buffer);
+        glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+        glBufferData(GL_UNIFORM_BUFFER, stride * slotCount, NULL, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+
+    ~UniformBufferRing()
+    {
+        for (size_t i = 0; i < fences.size(); i++)
+        {
+            if (fences[i])
+                glDeleteSync(fences[i]);
+        }
+        glDeleteBuffers(1, &buffer);
+    }
+
+    UniformBufferRing(const UniformBufferRing&) = delete;
+    UniformBufferRing& operator=(const UniformBufferRing&) = delete;
+
+    // Writes the block into the next slot and binds it for the draws that follow
+    void Update(const Block& block)
+    {
+        // Everything reading the previous slot has been issued by now
+        if (written)
+            fences[current] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        current = (current + 1) % fences.size();
+        if (fences[current])
+        {
+            glClientWaitSync(fences[current], GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+            glDeleteSync(fences[current]);
+            fences[current] = nullptr;
+        }
+
+        GLintptr offset = stride * (GLintptr)current;
+        glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+        void* data = glMapBufferRange(GL_UNIFORM_BUFFER, offset, sizeof(Block),
+            GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+        if (data)
+        {
+            std::memcpy(data, &block, sizeof(Block));
+            glUnmapBuffer(GL_UNIFORM_BUFFER);
+        }
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        glBindBufferRange(GL_UNIFORM_BUFFER, binding, buffer, offset, sizeof(Block));
+        written = true;
+    }
+
+private:
+    GLuint buffer;
+    GLuint binding;
+    // Size of a slot, rounded up to the offset alignment glBindBufferRange needs
+    GLsizeiptr stride;
+    std::vector<GLsync> fences;
+    size_t current;
+    bool written;
+};
+
+#endif
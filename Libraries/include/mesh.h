@@ -14,6 +14,8 @@
 using namespace std;
 
 #define MAX_BONE_INFLUENCE 4
+// first of the four attribute locations holding the per instance model matrix, one column each
+#define INSTANCE_MODEL_LOCATION 7
 
 struct Vertex {
     // position
@@ -32,18 +34,83 @@ struct Vertex {
     float m_Weights[MAX_BONE_INFLUENCE];
 };
 
+// kind of map a texture is, it decides the sampler the texture is bound to
+enum class TextureType : unsigned char {
+    Diffuse,
+    Specular,
+    Normal,
+    Height,
+    Count
+};
+
+// sampler name prefix of a texture type, the Nth texture of a type goes to prefix + N
+inline const char* TextureSamplerPrefix(TextureType type)
+{
+    switch (type)
+    {
+    case TextureType::Diffuse: return "texture_diffuse";
+    case TextureType::Specular: return "texture_specular";
+    case TextureType::Normal: return "texture_normal";
+    case TextureType::Height: return "texture_height";
+    default: return "";
+    }
+}
+
 struct Texture {
     unsigned int id;
-    string type;
+    TextureType type;
     string path;
 };
 
+// the textures of a mesh with their sampler names resolved up front. Built once when the mesh
+// is created, binding it is a few integer stores per texture without building any strings.
+class MeshMaterial
+{
+public:
+    struct Binding {
+        unsigned int texture;
+        UniformID sampler;
+        unsigned int unit;
+    };
+
+    MeshMaterial() {}
+
+    explicit MeshMaterial(const vector<Texture>& textures)
+    {
+        // texture_diffuse1, texture_diffuse2, texture_specular1 and so on, in the order given
+        unsigned int typeCounts[(int)TextureType::Count] = {};
+        bindings.reserve(textures.size());
+        for (unsigned int i = 0; i < textures.size(); i++)
+        {
+            unsigned int number = ++typeCounts[(int)textures[i].type];
+            string name = TextureSamplerPrefix(textures[i].type) + std::to_string(number);
+            bindings.push_back(Binding{ textures[i].id, Shader::GetUniformID(name), i });
+        }
+    }
+
+    void Bind(Shader& shader) const
+    {
+        for (size_t i = 0; i < bindings.size(); i++)
+        {
+            const Binding& binding = bindings[i];
+            glActiveTexture(GL_TEXTURE0 + binding.unit);
+            shader.setInt(binding.sampler, (int)binding.unit);
+            glBindTexture(GL_TEXTURE_2D, binding.texture);
+        }
+    }
+
+private:
+    vector<Binding> bindings;
+};
+
 class Mesh {
 public:
     // mesh Data
     vector<Vertex>       vertices;
     vector<unsigned int> indices;
     vector<Texture>      textures;
+    // built from textures in the constructor, rebuild it after changing them
+    MeshMaterial         material;
 
     unsigned int VAO;
 
@@ -53,6 +120,7 @@ public:
         this->vertices = vertices;
         this->indices = indices;
         this->textures = textures;
+        this->material = MeshMaterial(this->textures);
 
         // now that we have all the required data, set the vertex buffers and its attribute pointers.
         setupMesh();
@@ -62,31 +130,7 @@ public:
     // render the mesh
     void Draw(Shader& shader)
     {
-        // bind appropriate textures
-        unsigned int diffuseNr = 1;
-        unsigned int specularNr = 1;
-        unsigned int normalNr = 1;
-        unsigned int heightNr = 1;
-        for (unsigned int i = 0; i < textures.size(); i++)
-        {
-            glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
-            // retrieve texture number (the N in diffuse_textureN)
-            string number;
-            string name = textures[i].type;
-            if (name == "texture_diffuse")
-                number = std::to_string(diffuseNr++);
-            else if (name == "texture_specular")
-                number = std::to_string(specularNr++); // transfer unsigned int to string
-            else if (name == "texture_normal")
-                number = std::to_string(normalNr++); // transfer unsigned int to string
-            else if (name == "texture_height")
-                number = std::to_string(heightNr++); // transfer unsigned int to string
-
-            // now set the sampler to the correct texture unit
-            glUniform1i(glGetUniformLocation(shader.ID, (name + number).c_str()), i);
-            // and finally bind the texture
-            glBindTexture(GL_TEXTURE_2D, textures[i].id);
-        }
+        material.Bind(shader);
 
         // draw mesh
         glBindVertexArray(VAO);
@@ -97,9 +141,46 @@ public:
         glActiveTexture(GL_TEXTURE0);
     }
 
+    // render one copy of the mesh per model matrix with a single draw call. The matrices are
+    // streamed into the instance buffer, the shader reads them from INSTANCE_MODEL_LOCATION.
+    void DrawInstanced(Shader& shader, const glm::mat4* models, unsigned int count)
+    {
+        if (count == 0)
+            return;
+        material.Bind(shader);
+
+        glBindVertexArray(VAO);
+        // orphan the old storage first, so the upload doesn't wait for draws still reading it
+        glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+        glBufferData(GL_ARRAY_BUFFER, count * sizeof(glm::mat4), NULL, GL_STREAM_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, count * sizeof(glm::mat4), models);
+
+        setInstanceAttributesEnabled(true);
+        glDrawElementsInstanced(GL_TRIANGLES, static_cast<unsigned int>(indices.size()), GL_UNSIGNED_INT, 0, count);
+        setInstanceAttributesEnabled(false);
+        glBindVertexArray(0);
+
+        glActiveTexture(GL_TEXTURE0);
+    }
+
 private:
     // render data 
     unsigned int VBO, EBO;
+    // per instance model matrices, created with the mesh so copies of it share the buffer
+    unsigned int instanceVBO;
+
+    // the matrix attributes only read the instance buffer during instanced draws. While they are
+    // off the shader sees a constant value instead of reading past the end of the buffer.
+    void setInstanceAttributesEnabled(bool enabled)
+    {
+        for (unsigned int column = 0; column < 4; column++)
+        {
+            if (enabled)
+                glEnableVertexAttribArray(INSTANCE_MODEL_LOCATION + column);
+            else
+                glDisableVertexAttribArray(INSTANCE_MODEL_LOCATION + column);
+        }
+    }
 
     // initializes all the buffer objects/arrays
     void setupMesh()
@@ -108,6 +189,7 @@ private:
         glGenVertexArrays(1, &VAO);
         glGenBuffers(1, &VBO);
         glGenBuffers(1, &EBO);
+        glGenBuffers(1, &instanceVBO);
 
         glBindVertexArray(VAO);
         // load data into vertex buffers
@@ -143,6 +225,14 @@ private:
         // weights
         glEnableVertexAttribArray(6);
         glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, m_Weights));
+
+        // instance model matrices, a mat4 attribute takes one location per column
+        glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+        for (unsigned int column = 0; column < 4; column++)
+        {
+            glVertexAttribPointer(INSTANCE_MODEL_LOCATION + column, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(column * sizeof(glm::vec4)));
+            glVertexAttribDivisor(INSTANCE_MODEL_LOCATION + column, 1);
+        }
         glBindVertexArray(0);
     }
 };
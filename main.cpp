@@ -14,6 +14,8 @@
 #include <SlugEngine.h>
 #include <Rigidbody.h>
 #include <Collision.h>
+#include <PhysicsWorld.h>
+#include <PhysicsThread.h>
 #include <Window.h>
 #include <ShadowConfiguration.h>
 #include <Shader.h>
@@ -51,9 +53,10 @@ int main()
 
     glfwSetCursorPosCallback(window, mouse_callback);
     glEnable(GL_DEPTH_TEST);
-    glEnable(GL_BLEND);
     glEnable(GL_MULTISAMPLE);
 
+    // Blending is only turned on for the passes that need it, like the blended items of the
+    // render queue
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
     glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 
@@ -72,6 +75,8 @@ int main()
     Model OurSphere("Resources/ball.obj");
 
     ShadowMapping shadowMapping(1500, 1500);
+    // Camera and light values every program reads, written once a frame
+    UniformBufferRing<FrameUniforms> frameUniforms("FrameData");
 
     glm::vec3 boxRotation = glm::vec3(0.0f, 0.0f, 0.0f);
     glm::vec3 boxPosition = glm::vec3(0.0f, -5.0f, 0.0f); // Set the initial position
@@ -86,13 +91,29 @@ int main()
     Rigidbody rigidbody2(objectPosition2, 10.0f, glm::vec3(0.0f, -5.8f, 0.0f), 1.0f);
 
     boxRigidbody.setColliderRotation(glm::vec3(0.0f, 0.0f, 0.0f));
-
-    std::vector<Rigidbody> rigidbodies;
-    rigidbodies.push_back(boxRigidbody);
-    rigidbodies.push_back(rigidbody);
-    rigidbodies.push_back(rigidbody2);
-
-    std::vector<Rigidbody> instantiatedSpheres;
+    boxRigidbody.setStatic(true);
+
+    PhysicsWorld physicsWorld;
+    BodyHandle boxBody = physicsWorld.addBody(boxRigidbody);
+    BodyHandle sphereBody = physicsWorld.addBody(rigidbody);
+    BodyHandle sphereBody2 = physicsWorld.addBody(rigidbody2);
+
+    std::vector<BodyHandle> instantiatedSpheres;
+
+    // Models and materials are registered once, every frame only submits handles
+    RenderQueue renderQueue;
+    ModelHandle cubeModel = renderQueue.AddModel(OurModel);
+    ModelHandle sphereModel = renderQueue.AddModel(OurSphere);
+    RenderMaterial woodMaterial;
+    woodMaterial.diffuseTexture = woodTexture;
+    MaterialHandle wood = renderQueue.AddMaterial(woodMaterial);
+    RenderMaterial popCatMaterial;
+    popCatMaterial.diffuseTexture = popCat;
+    MaterialHandle popCatSkin = renderQueue.AddMaterial(popCatMaterial);
+
+    // Physics steps on its own thread from here on, the world is only touched through it
+    PhysicsThread physicsThread(physicsWorld);
+    physicsThread.start();
 
     // render loop
     // -----------
@@ -106,100 +127,86 @@ int main()
         glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
         glClear(GL_COLOR_BUFFER_BIT);
 
-        rigidbody.update(deltaTime);
-        rigidbody2.update(deltaTime);
-        boxRigidbody.update(deltaTime);
+        // Bodies far from the camera step less often
+        glm::vec3 focusPoint = camera.Position;
+        physicsThread.enqueue([focusPoint](PhysicsWorld& world) { world.setLodFocusPoints(&focusPoint, 1); });
 
+        // Moves are relative, so every frame still counts when several land before one step
+        glm::vec3 playerMove(0.0f);
         if (glfwGetKey(window, GLFW_KEY_LEFT) == GLFW_PRESS)
         {
-            rigidbody.setPosition(glm::vec3(rigidbody.getPosition().x, rigidbody.getPosition().y, rigidbody.getPosition().z + 0.1f));
+            playerMove.z += 0.1f;
         }
         if (glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS)
         {
-            rigidbody.setPosition(glm::vec3(rigidbody.getPosition().x, rigidbody.getPosition().y, rigidbody.getPosition().z - 0.1f));
+            playerMove.z -= 0.1f;
         }
         if (glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS)
         {
-            rigidbody.setPosition(glm::vec3(rigidbody.getPosition().x - 0.1f, rigidbody.getPosition().y, rigidbody.getPosition().z));
+            playerMove.x -= 0.1f;
         }
         if (glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS)
         {
-            rigidbody.setPosition(glm::vec3(rigidbody.getPosition().x + 0.1f, rigidbody.getPosition().y, rigidbody.getPosition().z));
+            playerMove.x += 0.1f;
+        }
+        if (playerMove != glm::vec3(0.0f))
+        {
+            physicsThread.enqueue([sphereBody, playerMove](PhysicsWorld& world) {
+                world.setPosition(sphereBody, world.getPosition(sphereBody) + playerMove);
+            });
         }
 
-        glm::mat4 model = makeModel(boxRigidbody, glm::vec3(1.0f, 1.0f, 1.0f));
-        glm::mat4 model2 = makeModel(rigidbody, glm::vec3(1.0f, 1.0f, 1.0f));
-        glm::mat4 model3 = makeModel(rigidbody2, glm::vec3(1.0f, 1.0f, 1.0f));
+        // Newest finished physics step, blended towards over one time step
+        const PhysicsSnapshot& snapshot = physicsThread.acquireSnapshot();
+        float alpha = snapshot.getInterpolationAlpha(PhysicsSnapshot::Clock::now());
 
-        // Check for collision only if the distance is less than a certain threshold
-        if (CollisionDetector::detectCollisions(rigidbody, boxRigidbody)) {
-            ResolveSphereVsBoundingBoxCollision(rigidbody, boxRigidbody);
-        }
-        if (CollisionDetector::detectCollisions(rigidbody2, boxRigidbody)) {
-            ResolveSphereVsBoundingBoxCollision(rigidbody2, boxRigidbody);
-        }
-        if (CollisionDetector::detectCollisions(rigidbody, rigidbody2)) {
-            ResolveSphereCollision(rigidbody, rigidbody2, deltaTime);
-        }
-        for (size_t i = 0; i < instantiatedSpheres.size(); ++i)
-        {
-            if (CollisionDetector::detectCollisions(instantiatedSpheres[i], boxRigidbody)) {
-                ResolveSphereVsBoundingBoxCollision(instantiatedSpheres[i], boxRigidbody);
-            }
-            if (CollisionDetector::detectCollisions(instantiatedSpheres[i], rigidbody)) {
-                ResolveSphereCollision(instantiatedSpheres[i], rigidbody, deltaTime);
-            }
-            for (size_t j = i + 1; j < instantiatedSpheres.size(); ++j) {
-                if (CollisionDetector::detectCollisions(instantiatedSpheres[i], instantiatedSpheres[j])) {
-                    ResolveSphereCollision(instantiatedSpheres[i], instantiatedSpheres[j], deltaTime);
-                }
+        // The ground doesn't cast shadows, every sphere does
+        renderQueue.Clear(camera.Position, 100.0f);
+        renderQueue.Submit(cubeModel, wood, makeModel(physicsThread, snapshot, boxBody, alpha, glm::vec3(1.0f, 1.0f, 1.0f)), false);
+        renderQueue.Submit(sphereModel, popCatSkin, makeModel(physicsThread, snapshot, sphereBody, alpha, glm::vec3(1.0f, 1.0f, 1.0f)));
+        renderQueue.Submit(sphereModel, popCatSkin, makeModel(physicsThread, snapshot, sphereBody2, alpha, glm::vec3(1.0f, 1.0f, 1.0f)));
+        for (size_t i = 0; i < instantiatedSpheres.size(); ++i) {
+            // Spheres spawned after the snapshot show up with the next one
+            if (!snapshot.contains(instantiatedSpheres[i])) {
+                continue;
             }
+            renderQueue.Submit(sphereModel, popCatSkin, makeModel(physicsThread, snapshot, instantiatedSpheres[i], alpha, glm::vec3(1.0f, 1.0f, 1.0f)));
         }
 
-        std::vector<std::pair<Model, glm::mat4>> models = {
-            {OurSphere, model2},
-            {OurSphere, model3}
-        }; 
+        FrameUniforms frame;
+        frame.projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
+        frame.view = camera.GetViewMatrix();
+        frame.lightPos = lightPos;
+        frame.padding = 0.0f;
+        frame.viewPos = camera.Position;
+        frame.farPlane = far_plane;
+        frameUniforms.Update(frame);
 
         shadowMapping.CreateDepthCubemap(lightPos, near_plane, far_plane);
 
-        shadowMapping.RenderDepthCubemap(ShadowShader, models);
+        shadowMapping.RenderDepthCubemap(ShadowShader, renderQueue);
 
         glViewport(0, 0, SCR_WIDTH, SCR_HEIGHT);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
         DefaultShader.use();
-        glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-        glm::mat4 view = camera.GetViewMatrix();
-        DefaultShader.setMat4("projection", projection);
-        DefaultShader.setMat4("view", view);
-        // set lighting uniforms
-        DefaultShader.setVec3("lightPos", lightPos);
-        DefaultShader.setVec3("viewPos", camera.Position);
+        // set lighting uniforms, the rest comes from the FrameData block
         DefaultShader.setInt("shadows", true);
-        DefaultShader.setFloat("far_plane", far_plane);
         DefaultShader.setFloat("lightIntensity", 1.5f);
 
-        renderObject(OurModel, model, DefaultShader, woodTexture);
-        renderObject(OurSphere, model2, DefaultShader, popCat);
-        renderObject(OurSphere, model3, DefaultShader, popCat);
-        for (size_t i = 0; i < instantiatedSpheres.size(); ++i) {
-
-            glm::mat4 model = makeModel(instantiatedSpheres[i], glm::vec3(1.0f, 1.0f, 1.0f));
-            renderObject(OurSphere, model, DefaultShader, popCat);
-            instantiatedSpheres[i].update(deltaTime);
-        }
+        renderQueue.Draw(DefaultShader);
 
         if (GetKeyDown(window, GLFW_KEY_U))
         {
             mySource.Play(mySound);
             Rigidbody newRigidbody(glm::vec3(0.0f, 20.0f, 0.0f), 10.f, glm::vec3(0.0f, -5.8f, 0.0f), 1.0f);
-            instantiatedSpheres.push_back(newRigidbody);
+            instantiatedSpheres.push_back(physicsThread.synchronize([&newRigidbody](PhysicsWorld& world) { return world.addBody(newRigidbody); }));
         }
 
         RunProgram(window);
     }
 
+    physicsThread.stop();
     DefaultShader.deuse();
     ShadowShader.deuse();
     EndProgram();